@@ -0,0 +1,81 @@
+/*
+ ============================================================================
+ Name        : bench_bulk.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Batch allocate/free benchmark: pool_malloc_bulk/pool_free_bulk
+               against loops of pool_malloc/pool_free
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "include/pool_alloc.h"
+
+#define BLOCK_SIZE 64
+#define MAX_BATCH 256
+#define OBJECTS_PER_RUN 4000000
+
+static void* g_batch[MAX_BATCH];
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+  size_t sizes_list[1] = {BLOCK_SIZE};
+  if(!pool_init(sizes_list, 1)) {
+    printf("Pool init failed...\n");
+    return EXIT_FAILURE;
+  }
+
+  // Keep half the pool live so that every batch searches past occupied words
+  static void* live[MAX_HEAP_SIZE / BLOCK_SIZE];
+  size_t num_live = 0;
+  while((live[num_live] = pool_malloc(BLOCK_SIZE)) != NULL) {
+    num_live++;
+  }
+  for(size_t i = 0; i < num_live; i += 2) {
+    pool_free(live[i]);
+  }
+
+  printf("Batch allocate + free of %d B blocks, pool half full\n", BLOCK_SIZE);
+  printf("%-8s %16s %16s %8s\n", "batch", "single ns/obj", "bulk ns/obj", "speedup");
+
+  const size_t batch_sizes[] = {16, 64, 256};
+  for(size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+    size_t batch = batch_sizes[b];
+    size_t rounds = OBJECTS_PER_RUN / batch;
+
+    double start = nowNs();
+    for(size_t r = 0; r < rounds; r++) {
+      for(size_t i = 0; i < batch; i++) {
+        g_batch[i] = pool_malloc(BLOCK_SIZE);
+      }
+      for(size_t i = 0; i < batch; i++) {
+        pool_free(g_batch[i]);
+      }
+    }
+    double single_ns = (nowNs() - start) / (rounds * batch);
+
+    start = nowNs();
+    for(size_t r = 0; r < rounds; r++) {
+      if(pool_malloc_bulk(BLOCK_SIZE, g_batch, batch) != batch) {
+        printf("Bulk allocation ran out of space\n");
+        return EXIT_FAILURE;
+      }
+      pool_free_bulk(g_batch, batch);
+    }
+    double bulk_ns = (nowNs() - start) / (rounds * batch);
+
+    printf("%-8zu %16.1f %16.1f %7.1fx\n", batch, single_ns, bulk_ns, single_ns / bulk_ns);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/*
+ ============================================================================
+ Name        : bench_containers.cpp
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Standard containers on PoolAllocator and PoolResource against
+               the default allocator: list and map node churn, pmr
+               unordered_map churn and pmr vector growth
+ ============================================================================
+ */
+
+#include <config.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <map>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "include/pool_alloc.hpp"
+
+#if MAX_POOL_SIZE > (1 << 20)
+#define BENCH_POOL_BYTES (1 << 20)
+#else
+#define BENCH_POOL_BYTES MAX_POOL_SIZE
+#endif
+#define OPS 1000000
+#define LIVE 128              // Elements each container holds while it churns
+#define VECTOR_LEN 256        // Elements a vector grows to before it is cleared
+#define NUM_BLOCK_SIZES 8
+
+static uint8_t g_pool_mem[BENCH_POOL_BYTES];
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/*
+ * Pushes to the back and pops from the front of a list holding LIVE elements. Returns ns/op.
+ */
+template <typename List>
+static double runList(List& list, uint64_t* checksum) {
+  for(int i = 0; i < LIVE; i++) {
+    list.push_back(i);
+  }
+  double start = nowNs();
+  for(int i = 0; i < OPS; i++) {
+    *checksum += list.front();
+    list.pop_front();
+    list.push_back(i);
+  }
+  double ns = (nowNs() - start) / OPS;
+  list.clear();
+  return ns;
+}
+
+/*
+ * Erases and inserts random keys of a map holding about LIVE elements. Returns ns/op.
+ */
+template <typename Map>
+static double runMap(Map& map, uint64_t* checksum) {
+  uint32_t rng = 88172645u;
+  for(int i = 0; i < LIVE; i++) {
+    map[xorshift(&rng) % (2 * LIVE)] = i;
+  }
+  double start = nowNs();
+  for(int i = 0; i < OPS; i++) {
+    *checksum += map.erase(xorshift(&rng) % (2 * LIVE));
+    map[xorshift(&rng) % (2 * LIVE)] = i;
+  }
+  double ns = (nowNs() - start) / OPS;
+  *checksum += map.size();
+  map.clear();
+  return ns;
+}
+
+/*
+ * Grows a vector one element at a time to VECTOR_LEN, then starts over with a new one. Returns ns/op.
+ */
+template <typename Vector, typename... Args>
+static double runVector(uint64_t* checksum, Args&&... args) {
+  double start = nowNs();
+  for(int i = 0; i < OPS / VECTOR_LEN; i++) {
+    Vector vector(args...);
+    for(int j = 0; j < VECTOR_LEN; j++) {
+      vector.push_back(j);
+    }
+    *checksum += vector.back();
+  }
+  return (nowNs() - start) / (OPS / VECTOR_LEN * VECTOR_LEN);
+}
+
+static void report(const char* name, double default_ns, double pool_ns) {
+  std::printf("%-28s %14.1f %14.1f %8.2fx\n", name, default_ns, pool_ns, default_ns / pool_ns);
+}
+
+int main() {
+  // Mostly node-sized blocks, and a few for the vectors and bucket arrays as they grow
+  size_t sizes_list[NUM_BLOCK_SIZES] = {32, 48, 64, 128, 256, 512, 1024, 4096};
+  size_t weights[NUM_BLOCK_SIZES] = {40, 40, 4, 2, 2, 2, 2, 1};
+  pool_t* pool = pool_create_sized(g_pool_mem, sizeof(g_pool_mem), sizes_list, weights, NUM_BLOCK_SIZES, POOL_SIZE_BY_WEIGHT, NULL);
+  if(pool == nullptr) {
+    std::printf("Pool creation failed...\n");
+    return EXIT_FAILURE;
+  }
+  uint64_t default_sum = 0;
+  uint64_t pool_sum = 0;
+
+  std::printf("Containers on the default allocator against a %u B pool; %d live elements\n", (unsigned)BENCH_POOL_BYTES, LIVE);
+  std::printf("%-28s %14s %14s %8s\n", "workload", "default ns/op", "pool ns/op", "speedup");
+  {
+    std::list<int> default_list;
+    std::list<int, pool_alloc::PoolAllocator<int>> pool_list{pool_alloc::PoolAllocator<int>(pool)};
+    report("list push/pop", runList(default_list, &default_sum), runList(pool_list, &pool_sum));
+  }
+  {
+    std::map<int, int> default_map;
+    std::map<int, int, std::less<int>, pool_alloc::PoolAllocator<std::pair<const int, int>>> pool_map{pool_alloc::PoolAllocator<std::pair<const int, int>>(pool)};
+    report("map erase/insert", runMap(default_map, &default_sum), runMap(pool_map, &pool_sum));
+  }
+#ifdef POOL_ALLOC_HAS_PMR
+  pool_alloc::PoolResource resource(pool);
+  {
+    std::pmr::unordered_map<int, int> default_map(std::pmr::new_delete_resource());
+    std::pmr::unordered_map<int, int> pool_map(&resource);
+    report("pmr unordered_map churn", runMap(default_map, &default_sum), runMap(pool_map, &pool_sum));
+  }
+  report("pmr vector growth", runVector<std::pmr::vector<int>>(&default_sum, std::pmr::new_delete_resource()),
+         runVector<std::pmr::vector<int>>(&pool_sum, &resource));
+#endif
+
+  // Both sides run the same operations, so their results must match
+  if(default_sum != pool_sum) {
+    std::printf("Checksum mismatch: %llu against %llu\n", (unsigned long long)default_sum, (unsigned long long)pool_sum);
+    return EXIT_FAILURE;
+  }
+  pool_region_stats_t stats[NUM_BLOCK_SIZES];
+  pool_stats_h(pool, stats, NUM_BLOCK_SIZES);
+  for(size_t i = 0; i < NUM_BLOCK_SIZES; i++) {
+    if(stats[i].live != 0) {
+      std::printf("%zu B blocks still live after the containers went away\n", stats[i].block_size);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
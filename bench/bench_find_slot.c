@@ -0,0 +1,114 @@
+/*
+ ============================================================================
+ Name        : bench_find_slot.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Occupation map scan benchmark at 50%, 90% and 99% occupancy
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "include/pool_alloc.h"
+
+#define BLOCK_SIZE 8
+#define MAX_SLOTS (MAX_HEAP_SIZE / BLOCK_SIZE)
+#define ITERATIONS 200000
+
+static void* g_slots[MAX_SLOTS];
+static uint8_t g_legacy_map[MAX_SLOTS / 8];
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Byte-then-bit occupation map scan used by pool_malloc before the word-at-a-time rewrite
+static bool legacyFindFreeSlot(uint8_t* om, uint16_t om_size, uint16_t* blk_free_loc) {
+  uint16_t free_loc = 0;
+  for(uint16_t om_byte_idx = 0; om_byte_idx < om_size; om_byte_idx++) {
+    uint8_t om_byte_val = om[om_byte_idx];
+    if(om_byte_val != 255){
+      for(uint8_t i = 0; i < 8; i++){
+        if(om_byte_val & 0x1) {
+          free_loc++;
+          om_byte_val = om_byte_val >> 0x1;
+        } else {
+          om[om_byte_idx] |= (0x1 << i);
+          *blk_free_loc = free_loc;
+          return true;
+        }
+      }
+    } else {
+      free_loc += 8;
+    }
+  }
+  return false;
+}
+
+int main(void) {
+  size_t sizes_list[1] = {BLOCK_SIZE};
+  if(!pool_init(sizes_list, 1)) {
+    printf("Pool init failed...\n");
+    return EXIT_FAILURE;
+  }
+
+  // Slots are handed out lowest-first, so filling the pool front to back yields slot order
+  size_t num_slots = 0;
+  while((num_slots < MAX_SLOTS) && ((g_slots[num_slots] = pool_malloc(BLOCK_SIZE)) != NULL)) {
+    num_slots++;
+  }
+  for(size_t i = 0; i < num_slots; i++) {
+    pool_free(g_slots[i]);
+  }
+
+#if defined(POOL_USE_SIMD) && defined(__AVX2__)
+  const char* scan_path = "AVX2";
+#elif defined(POOL_USE_SIMD) && defined(__SSE2__)
+  const char* scan_path = "SSE2";
+#else
+  const char* scan_path = "scalar";
+#endif
+  printf("Occupation map scan: %zu slots of %d B, %s word scan\n", num_slots, BLOCK_SIZE, scan_path);
+  printf("%-10s %14s %14s %8s\n", "occupancy", "byte scan ns", "word scan ns", "speedup");
+
+  const unsigned occupancy_pct[] = {50, 90, 99};
+  size_t live = 0;
+  uint16_t legacy_bytes = (num_slots + 7) / 8;
+  for(size_t level = 0; level < sizeof(occupancy_pct) / sizeof(occupancy_pct[0]); level++) {
+    // Occupy the leading slots so every search walks the full occupied prefix
+    size_t target = num_slots * occupancy_pct[level] / 100;
+    for(; live < target; live++) {
+      g_slots[live] = pool_malloc(BLOCK_SIZE);
+    }
+    for(size_t i = 0; i < legacy_bytes; i++) {
+      g_legacy_map[i] = 0;
+    }
+    for(size_t i = 0; i < target; i++) {
+      g_legacy_map[i / 8] |= 0x1 << (i % 8);
+    }
+
+    double start = nowNs();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+      uint16_t slot = 0;
+      legacyFindFreeSlot(g_legacy_map, legacy_bytes, &slot);
+      g_legacy_map[slot / 8] &= ~(0x1 << (slot % 8));
+    }
+    double legacy_ns = (nowNs() - start) / ITERATIONS;
+
+    start = nowNs();
+    for(size_t i = 0; i < ITERATIONS; i++) {
+      pool_free(pool_malloc(BLOCK_SIZE));
+    }
+    double word_ns = (nowNs() - start) / ITERATIONS;
+
+    printf("%8u%% %14.1f %14.1f %7.1fx\n", occupancy_pct[level], legacy_ns, word_ns, legacy_ns / word_ns);
+  }
+  return EXIT_SUCCESS;
+}
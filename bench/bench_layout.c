@@ -0,0 +1,209 @@
+/*
+ ============================================================================
+ Name        : bench_layout.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Cache misses of the inline and split metadata layouts: one
+               thread writing its block while another allocates next to it,
+               and random churn over many block sizes with the blocks touched
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+#include "include/pool_alloc.h"
+
+// Pools are capped at 16 MiB so that large-pool builds still run in seconds
+#if MAX_POOL_SIZE > (16 << 20)
+#define BENCH_POOL_BYTES (16 << 20)
+#else
+#define BENCH_POOL_BYTES MAX_POOL_SIZE
+#endif
+#define SHARING_OPS 2000000         // Allocate/free pairs of the allocating thread
+#define SHARING_BLOCKS 64
+#define CHURN_OPS 4000000
+#define CHURN_CLASSES 8
+#define CHURN_LIVE 4096             // Working set of the churn, spread over every block size
+
+typedef enum {
+  COUNTER_CACHE_MISSES,
+  COUNTER_L1D_MISSES,
+  NUM_COUNTERS
+} counter_t;
+
+typedef struct {
+  int fd[NUM_COUNTERS];
+} counters_t;
+
+typedef struct {
+  volatile uint64_t* block;
+  volatile bool stop;
+  uint64_t writes;
+} writer_t;
+
+static uint8_t g_pool_mem[BENCH_POOL_BYTES] __attribute__((aligned(64)));
+static void* g_live[CHURN_LIVE];
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static int openCounter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;          // Count threads started after the counter is opened
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Opens and starts the counters of this process; counters the kernel or hardware refuses read as n/a.
+ */
+static void countersStart(counters_t* c) {
+  c->fd[COUNTER_CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  c->fd[COUNTER_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  for(int k = 0; k < NUM_COUNTERS; k++) {
+    if(c->fd[k] >= 0) {
+      ioctl(c->fd[k], PERF_EVENT_IOC_RESET, 0);
+      ioctl(c->fd[k], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+static void countersStop(counters_t* c, const char* label, double ns_per_op, size_t ops) {
+  printf("%-22s %10.1f", label, ns_per_op);
+  for(int k = 0; k < NUM_COUNTERS; k++) {
+    uint64_t count;
+    if((c->fd[k] >= 0) && (ioctl(c->fd[k], PERF_EVENT_IOC_DISABLE, 0) == 0) && (read(c->fd[k], &count, sizeof(count)) == sizeof(count))) {
+      printf(" %16.3f", (double)count / ops);
+    } else {
+      printf(" %16s", "n/a");
+    }
+    if(c->fd[k] >= 0) {
+      close(c->fd[k]);
+    }
+  }
+  printf("\n");
+}
+
+static void* writerThread(void* arg) {
+  writer_t* w = arg;
+  while(!w->stop) {
+    (*w->block)++;
+    w->writes++;
+  }
+  return NULL;
+}
+
+/*
+ * One thread keeps writing the first block of a 32 B region while this thread allocates and frees the
+ * block after it. Inline, that block shares a cache line with the occupation map every allocation writes.
+ * The bulk calls go straight to the occupation map, past any per-thread cache.
+ */
+static void runSharing(pool_layout_t layout, const char* label) {
+  size_t sizes_list[1] = {32};
+  size_t targets[1] = {SHARING_BLOCKS};
+  pool_t* pool = pool_create_layout(g_pool_mem, sizeof(g_pool_mem), sizes_list, NULL, targets, 1, POOL_SIZE_BY_COUNT, layout, NULL);
+  if(pool == NULL) {
+    printf("%-22s pool creation failed\n", label);
+    return;
+  }
+  writer_t writer = {.block = pool_malloc_h(pool, 32)};
+
+  counters_t counters;
+  countersStart(&counters);
+  pthread_t thread;
+  pthread_create(&thread, NULL, writerThread, &writer);
+  double start = nowNs();
+  for(size_t i = 0; i < SHARING_OPS; i++) {
+    void* ptr;
+    if(pool_malloc_bulk_h(pool, 32, &ptr, 1) == 1) {
+      pool_free_bulk_h(pool, &ptr, 1);
+    }
+  }
+  double elapsed = nowNs() - start;
+  writer.stop = true;
+  pthread_join(thread, NULL);
+  countersStop(&counters, label, elapsed / SHARING_OPS, SHARING_OPS);
+}
+
+/*
+ * Replaces random members of a working set spread over CHURN_CLASSES block sizes, writing each new block.
+ * Inline, the occupation maps sit between the blocks of different regions; split, they share a few lines.
+ */
+static void runChurn(pool_layout_t layout, const char* label) {
+  size_t sizes_list[CHURN_CLASSES] = {16, 24, 32, 48, 64, 96, 128, 256};
+  pool_t* pool = pool_create_layout(g_pool_mem, sizeof(g_pool_mem), sizes_list, NULL, NULL, CHURN_CLASSES, POOL_SIZE_BY_WEIGHT, layout, NULL);
+  if(pool == NULL) {
+    printf("%-22s pool creation failed\n", label);
+    return;
+  }
+  // Keep the working set within what the smallest regions hold
+  size_t capacity = SIZE_MAX;
+  pool_region_stats_t stats[CHURN_CLASSES];
+  pool_stats_h(pool, stats, CHURN_CLASSES);
+  for(size_t c = 0; c < CHURN_CLASSES; c++) {
+    capacity = (stats[c].capacity < capacity) ? stats[c].capacity : capacity;
+  }
+  size_t live = capacity * CHURN_CLASSES / 2;
+  live = (live < CHURN_LIVE) ? live : CHURN_LIVE;
+  uint32_t rng = 12345;
+  for(size_t i = 0; i < live; i++) {
+    g_live[i] = pool_malloc_h(pool, sizes_list[i % CHURN_CLASSES]);
+  }
+
+  counters_t counters;
+  countersStart(&counters);
+  double start = nowNs();
+  for(size_t i = 0; i < CHURN_OPS; i++) {
+    size_t slot = xorshift(&rng) % live;
+    size_t size = sizes_list[xorshift(&rng) % CHURN_CLASSES];
+    pool_free_h(pool, g_live[slot]);
+    g_live[slot] = pool_malloc_h(pool, size);
+    if(g_live[slot] != NULL) {
+      memset(g_live[slot], (int)i, size);
+    }
+  }
+  double elapsed = nowNs() - start;
+  countersStop(&counters, label, elapsed / CHURN_OPS, CHURN_OPS);
+  for(size_t i = 0; i < live; i++) {
+    pool_free_h(pool, g_live[i]);
+  }
+  pool_magazine_flush();
+}
+
+int main(void) {
+  printf("Metadata layout, %u B pool; counts are per op and n/a where perf events are unavailable\n", (unsigned)BENCH_POOL_BYTES);
+  printf("%-22s %10s %16s %16s\n", "workload", "ns/op", "cache misses", "L1D load misses");
+  runSharing(POOL_LAYOUT_INLINE, "shared line, inline");
+  runSharing(POOL_LAYOUT_SPLIT, "shared line, split");
+  runChurn(POOL_LAYOUT_INLINE, "8-class churn, inline");
+  runChurn(POOL_LAYOUT_SPLIT, "8-class churn, split");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/*
+ ============================================================================
+ Name        : bench_locality.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Pointer chasing through linked lists whose nodes were placed
+               by first-fit, next-fit and pool_malloc_near after churn;
+               reports the time per hop and how many hops stay on the same
+               cache line and page
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "include/pool_alloc.h"
+
+#if MAX_POOL_SIZE > (16 << 20)
+#define BENCH_POOL_BYTES (16 << 20)
+#else
+#define BENCH_POOL_BYTES MAX_POOL_SIZE
+#endif
+#define NUM_LISTS 64
+#define CHURN_ROUNDS 4        // Times every live node is replaced before the lists are walked
+#define MIN_HOPS 5000000      // Hops walked per placement, over as many passes as it takes
+#define CACHE_LINE 64
+#define PAGE 4096
+
+typedef struct node {
+  struct node* next;
+  uint64_t payload[3];
+} node_t;
+
+typedef enum {
+  PLACE_FIRST_FIT,
+  PLACE_NEXT_FIT,
+  PLACE_NEAR,
+  NUM_PLACEMENTS
+} placement_t;
+
+typedef struct {
+  node_t* head[NUM_LISTS];
+  node_t* tail[NUM_LISTS];
+} lists_t;
+
+static uint8_t g_pool_mem[BENCH_POOL_BYTES];
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void append(pool_t* pool, lists_t* lists, size_t l, placement_t placement, uint64_t value) {
+  node_t* tail = lists->tail[l];
+  node_t* node = (placement == PLACE_NEAR) ? pool_malloc_near_h(pool, sizeof(node_t), tail) : pool_malloc_h(pool, sizeof(node_t));
+  if(node == NULL) {
+    printf("Pool ran out of nodes\n");
+    exit(EXIT_FAILURE);
+  }
+  *node = (node_t){.next = NULL, .payload = {value}};
+  if(tail != NULL) {
+    tail->next = node;
+  } else {
+    lists->head[l] = node;
+  }
+  lists->tail[l] = node;
+}
+
+/*
+ * Appends live nodes to random lists, then replaces the head of a random list with a new tail on another one
+ * CHURN_ROUNDS times over, so that each list's nodes are interleaved with those of every other list.
+ */
+static void buildLists(pool_t* pool, lists_t* lists, size_t live, placement_t placement) {
+  uint32_t rng = 2463534242u;
+  *lists = (lists_t){.head = {NULL}, .tail = {NULL}};
+  for(size_t i = 0; i < live; i++) {
+    append(pool, lists, xorshift(&rng) % NUM_LISTS, placement, i);
+  }
+  for(size_t i = 0; i < CHURN_ROUNDS * live; i++) {
+    size_t from = xorshift(&rng) % NUM_LISTS;
+    node_t* head = lists->head[from];
+    if(head != NULL) {
+      lists->head[from] = head->next;
+      if(head->next == NULL) {
+        lists->tail[from] = NULL;
+      }
+      pool_free_h(pool, head);
+    }
+    append(pool, lists, xorshift(&rng) % NUM_LISTS, placement, live + i);
+  }
+}
+
+/*
+ * Walks every list from head to tail until at least MIN_HOPS hops are done. Returns ns/hop.
+ */
+static double walkLists(const lists_t* lists, uint64_t* checksum) {
+  size_t hops = 0;
+  double start = nowNs();
+  while(hops < MIN_HOPS) {
+    for(size_t l = 0; l < NUM_LISTS; l++) {
+      for(const node_t* node = lists->head[l]; node != NULL; node = node->next) {
+        *checksum += node->payload[0];
+        hops++;
+      }
+    }
+  }
+  return (nowNs() - start) / hops;
+}
+
+/*
+ * Fraction of the links between consecutive nodes that stay within one cache line and within one page.
+ */
+static void linkLocality(const lists_t* lists, double* same_line, double* same_page) {
+  size_t links = 0;
+  size_t lines = 0;
+  size_t pages = 0;
+  for(size_t l = 0; l < NUM_LISTS; l++) {
+    for(const node_t* node = lists->head[l]; (node != NULL) && (node->next != NULL); node = node->next) {
+      uintptr_t from = (uintptr_t)node;
+      uintptr_t to = (uintptr_t)node->next;
+      links++;
+      lines += (from / CACHE_LINE == to / CACHE_LINE);
+      pages += (from / PAGE == to / PAGE);
+    }
+  }
+  *same_line = (links > 0) ? 100.0 * lines / links : 0.0;
+  *same_page = (links > 0) ? 100.0 * pages / links : 0.0;
+}
+
+int main(void) {
+  size_t sizes_list[1] = {sizeof(node_t)};
+  pool_t* pool = pool_create(g_pool_mem, sizeof(g_pool_mem), sizes_list, 1);
+  if(pool == NULL) {
+    printf("Pool creation failed...\n");
+    return EXIT_FAILURE;
+  }
+  pool_region_stats_t stats;
+  pool_stats_h(pool, &stats, 1);
+  // Leave a quarter of the region free, so that churn has holes to fill
+  size_t live = stats.capacity * 3 / 4;
+
+  const char* names[NUM_PLACEMENTS] = {"first-fit", "next-fit", "pool_malloc_near"};
+  static lists_t lists;
+  uint64_t checksums[NUM_PLACEMENTS] = {0};
+  printf("Pointer chasing over %d lists of %zu B nodes: %zu live in a %u B pool\n", NUM_LISTS, sizeof(node_t), live, (unsigned)BENCH_POOL_BYTES);
+  printf("%-18s %12s %14s %14s\n", "placement", "ns/hop", "same line %", "same page %");
+  for(placement_t p = 0; p < NUM_PLACEMENTS; p++) {
+    pool_reset_h(pool);
+    pool_set_placement_h(pool, (p == PLACE_NEXT_FIT) ? POOL_PLACE_NEXT_FIT : POOL_PLACE_FIRST_FIT);
+    buildLists(pool, &lists, live, p);
+    double same_line;
+    double same_page;
+    linkLocality(&lists, &same_line, &same_page);
+    double ns = walkLists(&lists, &checksums[p]);
+    printf("%-18s %12.2f %14.1f %14.1f\n", names[p], ns, same_line, same_page);
+  }
+
+  // Every placement builds the same lists, only at other addresses
+  for(placement_t p = 1; p < NUM_PLACEMENTS; p++) {
+    if(checksums[p] != checksums[0]) {
+      printf("Checksum mismatch: %s walked other lists than %s\n", names[p], names[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
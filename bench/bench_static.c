@@ -0,0 +1,131 @@
+/*
+ ============================================================================
+ Name        : bench_static.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Compile-time configured pool from pool_gen against the
+               runtime-configured pool_malloc/pool_free on the same layout
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "include/pool_alloc.h"
+#include "bench_static_pool.h"     // pool_gen bench 65536 16 32 64 128, generated at build time
+
+#define CHURN_OPS 4000000
+#define LIVE_BLOCKS 1024
+#define MAX_REQUEST 128
+
+static void* g_live[LIVE_BLOCKS];
+static size_t g_live_size[LIVE_BLOCKS];
+static size_t g_requests[CHURN_OPS];
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/*
+ * Allocate/free pairs of one size, then churn of a working set with random sizes freed through the
+ * plain and the sized free. Both pools run the same request sequence.
+ */
+static void runRuntime(double* ns) {
+  double start = nowNs();
+  for(size_t i = 0; i < CHURN_OPS; i++) {
+    pool_free(pool_malloc(32));
+  }
+  ns[0] = (nowNs() - start) / CHURN_OPS;
+
+  for(size_t sized = 0; sized < 2; sized++) {
+    for(size_t k = 0; k < LIVE_BLOCKS; k++) {
+      g_live_size[k] = g_requests[k];
+      g_live[k] = pool_malloc(g_live_size[k]);
+    }
+    start = nowNs();
+    for(size_t i = 0; i < CHURN_OPS; i++) {
+      size_t k = i % LIVE_BLOCKS;
+      if(sized) {
+        pool_free_sized(g_live[k], g_live_size[k]);
+      } else {
+        pool_free(g_live[k]);
+      }
+      g_live_size[k] = g_requests[i];
+      g_live[k] = pool_malloc(g_live_size[k]);
+    }
+    ns[1 + sized] = (nowNs() - start) / CHURN_OPS;
+    for(size_t k = 0; k < LIVE_BLOCKS; k++) {
+      pool_free(g_live[k]);
+    }
+  }
+}
+
+static void runGenerated(double* ns) {
+  double start = nowNs();
+  for(size_t i = 0; i < CHURN_OPS; i++) {
+    bench_free(bench_malloc(32));
+  }
+  ns[0] = (nowNs() - start) / CHURN_OPS;
+
+  for(size_t sized = 0; sized < 2; sized++) {
+    for(size_t k = 0; k < LIVE_BLOCKS; k++) {
+      g_live_size[k] = g_requests[k];
+      g_live[k] = bench_malloc(g_live_size[k]);
+    }
+    start = nowNs();
+    for(size_t i = 0; i < CHURN_OPS; i++) {
+      size_t k = i % LIVE_BLOCKS;
+      if(sized) {
+        bench_free_sized(g_live[k], g_live_size[k]);
+      } else {
+        bench_free(g_live[k]);
+      }
+      g_live_size[k] = g_requests[i];
+      g_live[k] = bench_malloc(g_live_size[k]);
+    }
+    ns[1 + sized] = (nowNs() - start) / CHURN_OPS;
+    for(size_t k = 0; k < LIVE_BLOCKS; k++) {
+      bench_free(g_live[k]);
+    }
+  }
+}
+
+int main(void) {
+  size_t sizes_list[4] = {16, 32, 64, 128};
+  if(!pool_init(sizes_list, 4)) {
+    printf("Pool init failed...\n");
+    return EXIT_FAILURE;
+  }
+  // Request sizes are drawn up front so that both pools see the same sequence
+  uint32_t rng = 2463534242u;
+  for(size_t i = 0; i < CHURN_OPS; i++) {
+    g_requests[i] = 1 + xorshift(&rng) % MAX_REQUEST;
+  }
+
+  double runtime_ns[3];
+  double generated_ns[3];
+  runRuntime(runtime_ns);
+  runGenerated(generated_ns);
+
+  const char* names[3] = {"32 B malloc+free", "random churn, free", "random churn, sized"};
+  printf("Runtime-configured against pool_gen pool: block sizes 16 32 64 128, %u B\n", (unsigned)MAX_HEAP_SIZE);
+  printf("%-22s %14s %14s %8s\n", "workload", "runtime ns/op", "static ns/op", "speedup");
+  for(size_t w = 0; w < 3; w++) {
+    printf("%-22s %14.1f %14.1f %7.2fx\n", names[w], runtime_ns[w], generated_ns[w], runtime_ns[w] / generated_ns[w]);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,416 @@
+/*
+ ============================================================================
+ Name        : bench_workloads.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Allocation workload benchmark against glibc malloc: fixed-size
+               churn, random sizes, fill-then-drain and LIFO/FIFO batches, on
+               one thread and several, with ns/op, latency percentiles and
+               peak bytes held
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
+
+#include "include/pool_alloc.h"
+
+// Pools are capped at 16 MiB so that large-pool builds still run in seconds
+#if MAX_POOL_SIZE > (16 << 20)
+#define BENCH_POOL_BYTES (16 << 20)
+#else
+#define BENCH_POOL_BYTES MAX_POOL_SIZE
+#endif
+#define DEFAULT_OPS 1000000         // Allocations plus frees per thread and run
+#define DEFAULT_THREADS 4
+#define DEFAULT_MAX_SIZE 256
+#define FIXED_SIZE 32
+#define MIN_BLOCK_SIZE 16
+#define BATCH_SIZE 64
+#define SAMPLE_EVERY 64             // One op in SAMPLE_EVERY is timed on its own for the percentiles
+#define PEAK_SAMPLE_OPS 65536       // Ops between two reads of the bytes held
+
+typedef enum {
+  DIST_FIXED,
+  DIST_UNIFORM,     // 1 .. max size, evenly
+  DIST_SKEWED,      // Product of two uniform draws; mostly small sizes with a long tail
+  DIST_BIMODAL      // 90% small objects of 8 .. max/8 bytes, 10% large ones of 3/4 max .. max
+} dist_t;
+
+typedef enum {
+  PATTERN_CHURN,        // Keep a working set live and replace random members of it
+  PATTERN_FILL_DRAIN,   // Fill most of the pool, then free everything in allocation order
+  PATTERN_LIFO,         // Allocate a small batch, free it newest first
+  PATTERN_FIFO          // Allocate a small batch, free it oldest first
+} pattern_t;
+
+typedef struct {
+  const char* name;
+  pattern_t pattern;
+  dist_t dist;
+} workload_t;
+
+typedef struct {
+  pool_t* pool;                 // NULL for glibc malloc
+  const workload_t* workload;
+  size_t max_size;
+  size_t ops;
+  size_t live_slots;            // Working set, fill or batch size of this thread
+  uint32_t rng;
+
+  size_t op;
+  size_t next_peak_op;
+  size_t failures;
+  double elapsed_ns;
+  float* samples;
+  size_t num_samples;
+} worker_t;
+
+static const workload_t g_workloads[] = {
+  {"churn 32B", PATTERN_CHURN, DIST_FIXED},
+  {"churn uniform", PATTERN_CHURN, DIST_UNIFORM},
+  {"churn skewed", PATTERN_CHURN, DIST_SKEWED},
+  {"churn bimodal", PATTERN_CHURN, DIST_BIMODAL},
+  {"fill-drain 32B", PATTERN_FILL_DRAIN, DIST_FIXED},
+  {"batch LIFO 32B", PATTERN_LIFO, DIST_FIXED},
+  {"batch FIFO 32B", PATTERN_FIFO, DIST_FIXED},
+};
+
+static size_t g_peak_bytes;
+static size_t g_baseline_bytes;
+
+static double nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint32_t nextRandom(uint32_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static size_t drawSize(dist_t dist, size_t max_size, uint32_t* rng) {
+  switch(dist) {
+    case DIST_FIXED:
+      return FIXED_SIZE;
+    case DIST_UNIFORM:
+      return 1 + nextRandom(rng) % max_size;
+    case DIST_SKEWED:
+      return 1 + (size_t)(nextRandom(rng) % max_size) * (nextRandom(rng) % max_size) / max_size;
+    case DIST_BIMODAL:
+      if(nextRandom(rng) % 10 != 0) {
+        return 8 + nextRandom(rng) % (max_size / 8 - 7);
+      }
+      return max_size * 3 / 4 + nextRandom(rng) % (max_size / 4 + 1);
+  }
+  return FIXED_SIZE;
+}
+
+/*
+ * Bytes currently held in blocks: live blocks times their block size for a pool, chunk bytes in use
+ * past the benchmark's own allocations for glibc.
+ */
+static size_t heldBytes(pool_t* pool) {
+  if(pool != NULL) {
+    pool_region_stats_t regions[UCHAR_MAX];
+    size_t num_regions = pool_stats_h(pool, regions, UCHAR_MAX);
+    size_t bytes = 0;
+    for(size_t i = 0; i < num_regions; i++) {
+      bytes += regions[i].live * regions[i].block_size;
+    }
+    return bytes;
+  }
+#ifdef HAVE_MALLINFO2
+  size_t in_use = mallinfo2().uordblks;
+  return (in_use > g_baseline_bytes) ? in_use - g_baseline_bytes : 0;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Reads the bytes held at one of the workload's high points, at most once every PEAK_SAMPLE_OPS ops.
+ */
+static void notePeak(worker_t* w) {
+  if(w->op < w->next_peak_op) {
+    return;
+  }
+  size_t bytes = heldBytes(w->pool);
+  size_t peak = __atomic_load_n(&g_peak_bytes, __ATOMIC_RELAXED);
+  while((bytes > peak) && !__atomic_compare_exchange_n(&g_peak_bytes, &peak, bytes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+  w->next_peak_op = w->op + PEAK_SAMPLE_OPS;
+}
+
+static inline void* benchAlloc(worker_t* w, size_t n) {
+  bool timed = ((w->op++ % SAMPLE_EVERY) == 0);
+  double start = timed ? nowNs() : 0;
+  void* ptr = (w->pool != NULL) ? pool_malloc_h(w->pool, n) : malloc(n);
+  if(timed) {
+    w->samples[w->num_samples++] = (float)(nowNs() - start);
+  }
+  if(ptr == NULL) {
+    w->failures++;
+  }
+  return ptr;
+}
+
+static inline void benchFree(worker_t* w, void* ptr) {
+  if(ptr == NULL) {
+    return;
+  }
+  bool timed = ((w->op++ % SAMPLE_EVERY) == 0);
+  double start = timed ? nowNs() : 0;
+  if(w->pool != NULL) {
+    pool_free_h(w->pool, ptr);
+  } else {
+    free(ptr);
+  }
+  if(timed) {
+    w->samples[w->num_samples++] = (float)(nowNs() - start);
+  }
+}
+
+static void* runWorker(void* arg) {
+  worker_t* w = arg;
+  const workload_t* workload = w->workload;
+  size_t live = w->live_slots;
+  void** slots = calloc(live, sizeof(void*));
+
+  double start = nowNs();
+  switch(workload->pattern) {
+    case PATTERN_CHURN:
+      for(size_t i = 0; i < live; i++) {
+        slots[i] = benchAlloc(w, drawSize(workload->dist, w->max_size, &w->rng));
+      }
+      while(w->op < w->ops) {
+        notePeak(w);
+        size_t victim = nextRandom(&w->rng) % live;
+        benchFree(w, slots[victim]);
+        slots[victim] = benchAlloc(w, drawSize(workload->dist, w->max_size, &w->rng));
+      }
+      for(size_t i = 0; i < live; i++) {
+        benchFree(w, slots[i]);
+      }
+      break;
+    case PATTERN_FILL_DRAIN:
+    case PATTERN_FIFO:
+    case PATTERN_LIFO:
+      while(w->op < w->ops) {
+        for(size_t i = 0; i < live; i++) {
+          slots[i] = benchAlloc(w, drawSize(workload->dist, w->max_size, &w->rng));
+        }
+        notePeak(w);
+        for(size_t i = 0; i < live; i++) {
+          benchFree(w, slots[(workload->pattern == PATTERN_LIFO) ? live - 1 - i : i]);
+        }
+      }
+      break;
+  }
+  w->elapsed_ns = nowNs() - start;
+  free(slots);
+  return NULL;
+}
+
+static int compareFloat(const void* a, const void* b) {
+  float x = *(const float*)a;
+  float y = *(const float*)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Creates a pool in mem for workload; random sizes get power-of-two block sizes weighted by how often
+ * the distribution lands in each. Returns the total number of blocks through capacity.
+ */
+static pool_t* createBenchPool(void* mem, const workload_t* workload, size_t max_size, uint32_t seed, size_t* capacity) {
+  size_t block_sizes[32];
+  size_t weights[32];
+  size_t capacities[32];
+  size_t num_sizes = 0;
+  if(workload->dist == DIST_FIXED) {
+    block_sizes[num_sizes] = FIXED_SIZE;
+    weights[num_sizes++] = 1;
+  } else {
+    size_t num_candidates = 0;
+    for(size_t size = MIN_BLOCK_SIZE; size / 2 < max_size; size *= 2) {
+      block_sizes[num_candidates] = size;
+      weights[num_candidates++] = 0;
+    }
+    uint32_t rng = seed;
+    for(size_t k = 0; k < 4096; k++) {
+      size_t n = drawSize(workload->dist, max_size, &rng);
+      size_t i = 0;
+      while(block_sizes[i] < n) {
+        i++;
+      }
+      weights[i]++;
+    }
+    // Drop the block sizes the distribution never lands in
+    for(size_t i = 0; i < num_candidates; i++) {
+      if(weights[i] > 0) {
+        block_sizes[num_sizes] = block_sizes[i];
+        weights[num_sizes++] = weights[i];
+      }
+    }
+  }
+  pool_t* pool = pool_create_sized(mem, BENCH_POOL_BYTES, block_sizes, weights, num_sizes, POOL_SIZE_BY_WEIGHT, capacities);
+  *capacity = 0;
+  for(size_t i = 0; (pool != NULL) && (i < num_sizes); i++) {
+    *capacity += capacities[i];
+  }
+  return pool;
+}
+
+/*
+ * Runs one workload on num_threads threads against pool (or glibc malloc when NULL) and prints its row.
+ */
+static void runWorkload(const workload_t* workload, pool_t* pool, size_t num_threads, size_t live_slots, size_t ops, size_t max_size, uint32_t seed) {
+  worker_t workers[num_threads];
+  pthread_t threads[num_threads];
+  size_t max_samples = (ops + 2 * live_slots) / SAMPLE_EVERY + 2;
+  float* samples = malloc(num_threads * max_samples * sizeof(float));
+
+  g_peak_bytes = 0;
+#ifdef HAVE_MALLINFO2
+  g_baseline_bytes = mallinfo2().uordblks;
+#endif
+  for(size_t t = 0; t < num_threads; t++) {
+    workers[t] = (worker_t){
+      .pool = pool, .workload = workload, .max_size = max_size, .ops = ops, .live_slots = live_slots,
+      .rng = seed + (uint32_t)t * 0x9E3779B9u, .samples = samples + t * max_samples,
+    };
+    if(workers[t].rng == 0) {
+      workers[t].rng = 1;
+    }
+    pthread_create(&threads[t], NULL, runWorker, &workers[t]);
+  }
+
+  double elapsed_ns = 0;
+  size_t total_ops = 0;
+  size_t failures = 0;
+  size_t num_samples = 0;
+  for(size_t t = 0; t < num_threads; t++) {
+    pthread_join(threads[t], NULL);
+    elapsed_ns += workers[t].elapsed_ns;
+    total_ops += workers[t].op;
+    failures += workers[t].failures;
+    // Pack every thread's samples together for sorting
+    memmove(samples + num_samples, workers[t].samples, workers[t].num_samples * sizeof(float));
+    num_samples += workers[t].num_samples;
+  }
+  qsort(samples, num_samples, sizeof(float), compareFloat);
+
+  char peak[16] = "-";
+#ifndef HAVE_MALLINFO2
+  if(pool != NULL)
+#endif
+  {
+    snprintf(peak, sizeof(peak), "%.1f", g_peak_bytes / 1024.0);
+  }
+  printf("%-16s %-6s %3zu %8.1f %8.0f %8.0f %8.0f %10s %8zu\n", workload->name, (pool != NULL) ? "pool" : "glibc", num_threads,
+         elapsed_ns / total_ops, samples[num_samples / 2], samples[num_samples * 99 / 100], samples[num_samples * 999 / 1000], peak, failures);
+  free(samples);
+}
+
+static void usage(const char* prog) {
+  printf("Usage: %s [-n ops per thread] [-t threads] [-d uniform|skewed|bimodal|all] [-m max size] [-s seed]\n", prog);
+}
+
+int main(int argc, char** argv) {
+  size_t ops = DEFAULT_OPS;
+  size_t max_threads = DEFAULT_THREADS;
+  size_t max_size = DEFAULT_MAX_SIZE;
+  uint32_t seed = 1;
+  const char* dist_name = "all";
+  int opt;
+  while((opt = getopt(argc, argv, "n:t:d:m:s:h")) != -1) {
+    switch(opt) {
+      case 'n': ops = strtoull(optarg, NULL, 0); break;
+      case 't': max_threads = strtoull(optarg, NULL, 0); break;
+      case 'd': dist_name = optarg; break;
+      case 'm': max_size = strtoull(optarg, NULL, 0); break;
+      case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+      default:
+        usage(argv[0]);
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  dist_t only_dist = DIST_FIXED;
+  if(strcmp(dist_name, "uniform") == 0) {
+    only_dist = DIST_UNIFORM;
+  } else if(strcmp(dist_name, "skewed") == 0) {
+    only_dist = DIST_SKEWED;
+  } else if(strcmp(dist_name, "bimodal") == 0) {
+    only_dist = DIST_BIMODAL;
+  } else if(strcmp(dist_name, "all") != 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if((ops == 0) || (max_threads == 0) || (max_size < 64) || (max_size > BENCH_POOL_BYTES / 64) || (seed == 0)) {
+    printf("Need ops and threads > 0, max size 64..%d and a non-zero seed\n", BENCH_POOL_BYTES / 64);
+    return EXIT_FAILURE;
+  }
+
+  void* mem = malloc(BENCH_POOL_BYTES);
+#if defined(POOL_MAGAZINES)
+  const char* mode = "thread-safe, magazines";
+#elif defined(POOL_THREAD_SAFE)
+  const char* mode = "thread-safe";
+#else
+  const char* mode = "single-threaded";
+#endif
+  printf("Workloads: %zu ops per thread, %d B pool (%s), sizes up to %zu B, seed %u\n", ops, BENCH_POOL_BYTES, mode, max_size, (unsigned)seed);
+  printf("Latencies in ns from one op in %d, timer overhead included; peak = bytes held in blocks\n", SAMPLE_EVERY);
+  printf("%-16s %-6s %3s %8s %8s %8s %8s %10s %8s\n", "workload", "alloc", "thr", "ns/op", "p50", "p99", "p99.9", "peak KiB", "failed");
+
+  size_t thread_counts[2] = {1, max_threads};
+  for(size_t k = 0; k < sizeof(g_workloads) / sizeof(g_workloads[0]); k++) {
+    const workload_t* workload = &g_workloads[k];
+    if((workload->dist != DIST_FIXED) && (only_dist != DIST_FIXED) && (workload->dist != only_dist)) {
+      continue;
+    }
+    for(size_t c = 0; c < ((max_threads > 1) ? 2 : 1); c++) {
+      size_t num_threads = thread_counts[c];
+      size_t capacity;
+      pool_t* pool = createBenchPool(mem, workload, max_size, seed, &capacity);
+      if(pool == NULL) {
+        printf("%-16s pool does not fit %d B\n", workload->name, BENCH_POOL_BYTES);
+        continue;
+      }
+      // Leave headroom for blocks parked in other threads' caches and for spills between block sizes
+      size_t live_slots = capacity / 2 / num_threads;
+      if(workload->pattern == PATTERN_FILL_DRAIN) {
+        live_slots = capacity * 3 / 4 / num_threads;
+      } else if((workload->pattern != PATTERN_CHURN) && (live_slots > BATCH_SIZE)) {
+        live_slots = BATCH_SIZE;
+      }
+
+#ifdef POOL_THREAD_SAFE
+      runWorkload(workload, pool, num_threads, live_slots, ops, max_size, seed);
+#else
+      if(num_threads == 1) {
+        runWorkload(workload, pool, num_threads, live_slots, ops, max_size, seed);
+      } else {
+        printf("%-16s %-6s %3zu   needs --enable-thread-safe\n", workload->name, "pool", num_threads);
+      }
+#endif
+      runWorkload(workload, NULL, num_threads, live_slots, ops, max_size, seed);
+    }
+  }
+  free(mem);
+  return EXIT_SUCCESS;
+}
@@ -8,10 +8,39 @@
 #ifndef POOL_ALLOC_H_
 #define POOL_ALLOC_H_
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
-// Max number of bytes in heap data structure
+#include "pool_alloc_config.h"
+
+// Number of bytes in the default pool's heap
+#ifndef MAX_HEAP_SIZE
 #define MAX_HEAP_SIZE 65536
+#endif
+
+// Block sizes, region offsets and slot numbers are pool_index_t; pools built with --enable-large-pools may span up to 4 GiB.
+// Its width comes from the generated pool_alloc_config.h rather than config.h, so callers need not define anything to match the library.
+#if POOL_INDEX_BITS == 32
+typedef uint32_t pool_index_t;
+#define MAX_POOL_SIZE UINT32_MAX
+#else
+typedef uint16_t pool_index_t;
+#define MAX_POOL_SIZE 65536
+#endif
+
+#if MAX_HEAP_SIZE > MAX_POOL_SIZE
+#error "MAX_HEAP_SIZE exceeds MAX_POOL_SIZE; configure with --enable-large-pools"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Pool instance handle
+    Lives at the start of the memory given to pool_create; pool_init, pool_malloc and pool_free act on a built-in default instance.
+*/
+typedef struct pool pool_t;
 
 /** @brief heap initializer to populate metadata structures for future allocation.
     Will assert trap if initialization already completed once; or if the given configuration of the block_sizes list cannot fit the heap region given to the allocator.
@@ -21,36 +50,720 @@
 */
 bool pool_init(size_t* block_sizes, size_t block_size_count);
 
+/** @brief How pool_init_sized/pool_create_sized read their class_targets list */
+typedef enum {
+  POOL_SIZE_BY_WEIGHT,  ///< Block counts proportional to the targets; bytes left over are handed out evenly
+  POOL_SIZE_BY_COUNT,   ///< Exactly the target number of blocks per block size
+  POOL_SIZE_BY_BYTES    ///< As many blocks as fit in the target number of bytes, occupation maps included
+} pool_sizing_t;
+
+/** @brief heap initializer that sizes each block-size region from the expected workload instead of evenly
+    Will assert trap if initialization already completed once.
+    @param block_sizes A list of block sizes to be allocated
+    @param class_targets Weight, block count or byte budget for each entry of block_sizes, as given by sizing; every target must be non-zero
+    @param block_size_count Length of the block_sizes and class_targets lists
+    @param sizing How to read class_targets
+    @param capacities Optional list of block_size_count entries that receives the number of blocks of each block size; may be NULL
+    @return bool Success status of initialization; false if the targets do not fit the heap
+*/
+bool pool_init_sized(size_t* block_sizes, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities);
+
+/** @brief Per-block-size alignment settings for pool_init_aligned/pool_create_aligned
+    Any other power of two up to POOL_ALIGN_MAX is used as given. Slots of an aligned block size are spaced a multiple of the
+    alignment apart, so a 24 B block aligned to 16 takes 32 B; pool_stats reports the bytes this costs as padding.
+*/
+#define POOL_ALIGN_NATURAL 0        ///< Largest power of two dividing the block size, up to 16; enough for any type of that size
+#define POOL_ALIGN_PACKED 1         ///< Slots follow the occupation map back to back, as pool_init lays them out
+#define POOL_ALIGN_CACHE_LINE 64    ///< Every slot starts on its own cache line
+#define POOL_ALIGN_MAX 4096
+
+/** @brief heap initializer with an alignment setting for each block size
+    Will assert trap if initialization already completed once.
+    @param block_sizes A list of block sizes to be allocated
+    @param alignments POOL_ALIGN_NATURAL, POOL_ALIGN_PACKED or a power of two up to POOL_ALIGN_MAX for each entry of block_sizes
+    @param class_targets Optional weight, block count or byte budget for each entry of block_sizes, as in pool_init_sized; NULL sizes the regions evenly
+    @param block_size_count Length of the block_sizes, alignments and class_targets lists
+    @param sizing How to read class_targets
+    @param capacities Optional list of block_size_count entries that receives the number of blocks of each block size; may be NULL
+    @return bool Success status of initialization; false if an alignment is invalid or the regions do not fit the heap
+*/
+bool pool_init_aligned(size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities);
+
+/** @brief Where pool_init_layout/pool_create_layout put the occupation maps */
+typedef enum {
+  POOL_LAYOUT_INLINE,   ///< Each region's occupation map right in front of its slots, as pool_init lays them out
+  POOL_LAYOUT_SPLIT     ///< Every occupation and summary map in one cache-line-aligned metadata block at the start of the pool,
+                        ///< and every region's slots on a cache line boundary after it; writes to blocks never share a line with the maps
+} pool_layout_t;
+
+/** @brief heap initializer with a choice of metadata layout
+    Will assert trap if initialization already completed once.
+    @param block_sizes A list of block sizes to be allocated
+    @param alignments Optional POOL_ALIGN_* setting for each entry of block_sizes, as in pool_init_aligned; NULL packs every region
+    @param class_targets Optional weight, block count or byte budget for each entry of block_sizes, as in pool_init_sized; NULL sizes the regions evenly
+    @param block_size_count Length of the block_sizes, alignments and class_targets lists
+    @param sizing How to read class_targets
+    @param layout Where to put the occupation maps
+    @param capacities Optional list of block_size_count entries that receives the number of blocks of each block size; may be NULL
+    @return bool Success status of initialization; false if an argument is invalid or the regions do not fit the heap
+*/
+bool pool_init_layout(size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities);
+
 /** @brief Memory allocator
+    Safe to call concurrently with pool_malloc/pool_free when built with --enable-thread-safe.
     Will assert trap if pool is not initialized
     @param n number of bytes requested
     @return void* Pointer to allocated area; NULL if allocation failed
 */
 void* pool_malloc(size_t n);
 
+/** @brief Allocates count blocks of n bytes each
+    Claims up to 64 slots per pass over a region's occupation map, instead of one search per block, and spills into larger block sizes like pool_malloc.
+    Slots come straight from the occupation maps, bypassing the per-thread caches of --enable-magazines builds.
+    Will assert trap if pool is not initialized
+    @param n number of bytes requested per block
+    @param out list of count entries that receives the pointers
+    @param count number of blocks requested
+    @return size_t number of blocks allocated, in out[0] onwards; lower than count when the pool ran out of space
+*/
+size_t pool_malloc_bulk(size_t n, void** out, size_t count);
+
+/** @brief Allocates a block of n bytes whose address is a multiple of align
+    Takes the smallest block size that fits n and whose region is aligned to at least align, spilling into larger ones like pool_malloc.
+    pool_stats reports the alignment every region guarantees. Blocks are freed with pool_free as usual.
+    Will assert trap if pool is not initialized
+    @param align required alignment; a power of two
+    @param n number of bytes requested
+    @return void* Pointer to allocated area; NULL if align is not a power of two or no region aligned to it has a free block
+*/
+void* pool_aligned_alloc(size_t align, size_t n);
+
+/** @brief Allocates a block of n bytes as close as possible to hint, for objects used together such as the nodes of one list
+    When hint lies in the region n maps to, the slots of its occupation map word are searched first, nearest to hint's slot,
+    then the words on either side of it, moving outward up to 8 words (512 slots) away. Otherwise, or when none of those slots
+    is free, the block comes from pool_malloc's search. Slots come straight from the occupation maps, bypassing the per-thread
+    caches of --enable-magazines builds. Blocks are freed with pool_free as usual.
+    Will assert trap if pool is not initialized
+    @param n number of bytes requested
+    @param hint any address inside a block of the pool, such as the block allocated before; NULL allocates like pool_malloc
+    @return void* Pointer to allocated area; NULL if allocation failed
+*/
+void* pool_malloc_near(size_t n, const void* hint);
+
+/** @brief Where pool_malloc starts searching a region's occupation map, set with pool_set_placement */
+typedef enum {
+  POOL_PLACE_FIRST_FIT,   ///< Lowest free slot of the region, as pool_init sets up; keeps the live blocks packed at the start of each region
+  POOL_PLACE_NEXT_FIT     ///< First free slot at or after the occupation map word of the last claim, wrapping around at the end of the region;
+                          ///< blocks allocated in a row stay next to each other after churn has freed slots lower down
+} pool_placement_t;
+
+/** @brief Chooses how every region of the pool picks its free slots; call it after pool_init, before allocating
+    The policy may be changed later; it only moves where the next search starts. In --enable-thread-safe builds, next-fit
+    replaces the per-thread search starts, so threads allocating from one region contend on the same words.
+    Will assert trap if pool is not initialized
+    @param placement POOL_PLACE_FIRST_FIT or POOL_PLACE_NEXT_FIT
+    @return bool true if the policy was set; false if placement is not a pool_placement_t
+*/
+bool pool_set_placement(pool_placement_t placement);
+
 /** @brief Frees allocated memory
     Will assert trap if pool is not initialized or if the pointer is either out-of-bounds of the allocation area or unaligned
     @param ptr pointer to be freed
 */
 void pool_free(void* ptr);
 
+/** @brief Frees allocated memory whose requested size is known
+    Skips the pointer-to-region lookup when ptr lies in the block size that n maps to; falls back to pool_free when the allocation spilled into a larger block.
+    Will assert trap under the same conditions as pool_free
+    @param ptr pointer to be freed
+    @param n number of bytes requested from pool_malloc for ptr
+*/
+void pool_free_sized(void* ptr, size_t n);
+
+/** @brief Frees a list of allocated pointers
+    Consecutive pointers that share an occupation map word, such as the output of pool_malloc_bulk, are released with a single update.
+    Slots go straight back to the occupation maps, bypassing the per-thread caches of --enable-magazines builds.
+    Will assert trap under the same conditions as pool_free, or if a pointer appears twice in a row of the same word
+    @param ptrs pointers to be freed; NULL entries are skipped
+    @param count length of ptrs
+*/
+void pool_free_bulk(void** ptrs, size_t count);
+
+/** @brief Resizes an allocated block
+    Returns ptr itself, without copying, while n still maps to the block size ptr is in. A larger n moves the block to the smallest block
+    size that fits and has room, copying the whole old block. A smaller n that maps to a smaller block size moves the block down, copying
+    its first n bytes, so the larger block size gets its slot back; if those block sizes are full, ptr keeps its block.
+    Alignment beyond that of pool_malloc is not preserved across a move.
+    Will assert trap if pool is not initialized
+    @param ptr block to resize; NULL allocates like pool_malloc
+    @param n number of bytes requested; 0 frees ptr like pool_free
+    @return void* Pointer to the resized block; NULL if n is 0, or if ptr is not a block or no block of n bytes was free, in which case ptr is left as it was
+*/
+void* pool_realloc(void* ptr, size_t n);
+
+/** @brief Number of bytes usable in an allocated block, the block size it was taken from
+    Will assert trap if pool is not initialized
+    @param ptr allocated block
+    @return size_t usable bytes; 0 if ptr is NULL or not the start of a block
+*/
+size_t pool_usable_size(void* ptr);
+
+/** @brief Frees every block of the pool at once
+    Clears the occupation maps with a few wide stores per region instead of one pool_free per block; every pointer handed out so far becomes invalid.
+    Not safe to call concurrently with other calls on the pool. In --enable-magazines builds the calling thread's caches are emptied first, and other
+    threads that used the pool must have called pool_magazine_flush.
+    Will assert trap if pool is not initialized
+*/
+void pool_reset(void);
+
+/** @brief Frees every block of one block-size region at once; same conditions as pool_reset
+    Will assert trap if pool is not initialized
+    @param region index of the region in pool_stats order, smallest block size first
+    @return bool true if the region was reset; false if there is no such region
+*/
+bool pool_reset_region(size_t region);
+
+/** @brief Bytes of the buffer pool_mark needs; fixed for the lifetime of the pool */
+size_t pool_mark_size(void);
+
+/** @brief Records which blocks of the pool are allocated, so that pool_release can later free every block allocated since
+    Marks nest: each phase of a request takes its own mark and releases it on the way out. Same conditions as pool_reset.
+    Will assert trap if pool is not initialized
+    @param mark buffer of pool_mark_size() bytes, any alignment
+*/
+void pool_mark(void* mark);
+
+/** @brief Rolls the pool back to a mark: frees every block allocated since pool_mark, in one pass over the occupation maps
+    Blocks allocated before the mark and freed since are allocated again, so a phase should only free its own blocks.
+    Same conditions as pool_reset.
+    Will assert trap if pool is not initialized
+    @param mark buffer filled by pool_mark for this pool; it may be released again
+*/
+void pool_release(const void* mark);
+
+/** @brief Ends the default pool so that pool_init may build a new one
+    In --enable-magazines builds the calling thread's caches are emptied first, and slots other threads still cache for the pool are
+    dropped the next time they touch their caches. Every block becomes invalid.
+    Will assert trap if pool is not initialized
+*/
+void pool_destroy(void);
+
+/** @brief Creates a pool instance inside caller-supplied memory
+    The instance header, metadata and block-size regions are all laid out within mem, which must stay valid for the lifetime of the pool. Any number of pools can coexist.
+    End a pool with pool_destroy_h before its memory is freed or used for another pool; --enable-magazines builds would otherwise keep
+    handing out slots the threads cached for the old pool.
+    @param mem memory to build the pool in; need not be aligned
+    @param len length of mem in bytes; at most MAX_POOL_SIZE
+    @param block_sizes A list of block sizes to be allocated
+    @param block_size_count Length of the block_sizes list
+    @return pool_t* Handle to the pool; NULL if the arguments are invalid or the block_sizes list does not fit in mem
+*/
+pool_t* pool_create(void* mem, size_t len, size_t* block_sizes, size_t block_size_count);
+
+/** @brief pool_create with regions sized from the expected workload, as in pool_init_sized
+    @param mem memory to build the pool in; need not be aligned
+    @param len length of mem in bytes; at most MAX_POOL_SIZE
+    @param block_sizes A list of block sizes to be allocated
+    @param class_targets Weight, block count or byte budget for each entry of block_sizes, as given by sizing
+    @param block_size_count Length of the block_sizes and class_targets lists
+    @param sizing How to read class_targets
+    @param capacities Optional list that receives the number of blocks of each block size; may be NULL
+    @return pool_t* Handle to the pool; NULL if the arguments are invalid or the targets do not fit in mem
+*/
+pool_t* pool_create_sized(void* mem, size_t len, size_t* block_sizes, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities);
+
+/** @brief pool_create with an alignment setting for each block size, as in pool_init_aligned
+    @param mem memory to build the pool in; need not be aligned
+    @param len length of mem in bytes; at most MAX_POOL_SIZE
+    @param block_sizes A list of block sizes to be allocated
+    @param alignments POOL_ALIGN_NATURAL, POOL_ALIGN_PACKED or a power of two up to POOL_ALIGN_MAX for each entry of block_sizes
+    @param class_targets Optional weight, block count or byte budget for each entry of block_sizes; NULL sizes the regions evenly
+    @param block_size_count Length of the block_sizes, alignments and class_targets lists
+    @param sizing How to read class_targets
+    @param capacities Optional list that receives the number of blocks of each block size; may be NULL
+    @return pool_t* Handle to the pool; NULL if the arguments are invalid or the regions do not fit in mem
+*/
+pool_t* pool_create_aligned(void* mem, size_t len, size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities);
+
+/** @brief pool_create with a choice of metadata layout, as in pool_init_layout
+    @param mem memory to build the pool in; need not be aligned
+    @param len length of mem in bytes; at most MAX_POOL_SIZE
+    @param block_sizes A list of block sizes to be allocated
+    @param alignments Optional POOL_ALIGN_* setting for each entry of block_sizes; NULL packs every region
+    @param class_targets Optional weight, block count or byte budget for each entry of block_sizes; NULL sizes the regions evenly
+    @param block_size_count Length of the block_sizes, alignments and class_targets lists
+    @param sizing How to read class_targets
+    @param layout Where to put the occupation maps
+    @param capacities Optional list that receives the number of blocks of each block size; may be NULL
+    @return pool_t* Handle to the pool; NULL if the arguments are invalid or the regions do not fit in mem
+*/
+pool_t* pool_create_layout(void* mem, size_t len, size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities);
+
+/** @brief Backing options for pool_map and pool_map_default_heap; each one falls back to regular pages where the system lacks it */
+#define POOL_MAP_DEFAULT 0
+#define POOL_MAP_HUGE_PAGES 0x1               ///< Reserved huge pages (MAP_HUGETLB) if any are free, otherwise transparent huge pages
+#define POOL_MAP_TRANSPARENT_HUGE_PAGES 0x2   ///< Ask for transparent huge pages with madvise(MADV_HUGEPAGE)
+#define POOL_MAP_POPULATE 0x4                 ///< Fault every page in up front, on the bound node, instead of on first use
+#define POOL_MAP_NUMA_BOUND 0x8               ///< Reported by pool_map when the memory was bound to the requested node
+#define POOL_NUMA_ANY (-1)                    ///< No node binding; pages go wherever the first thread to touch them runs
+
+/** @brief Maps memory for pool_create from the operating system instead of a static array
+    Huge page mappings are rounded up to, and aligned on, 2 MiB. NUMA binding uses the mbind system call, so libnuma is not needed.
+    @param len bytes wanted; receives the bytes mapped, to pass to pool_create (capped at MAX_POOL_SIZE) and pool_unmap
+    @param flags POOL_MAP_* options
+    @param numa_node node to bind the memory to, or POOL_NUMA_ANY
+    @param granted Optional; receives the POOL_MAP_* options that took effect. May be NULL
+    @return void* mapped memory; NULL if len is 0 or the system cannot map it
+*/
+void* pool_map(size_t* len, unsigned flags, int numa_node, unsigned* granted);
+
+/** @brief Unmaps memory from pool_map; every pool created in it must be out of use
+    @param mem memory returned by pool_map
+    @param len length pool_map wrote back
+*/
+void pool_unmap(void* mem, size_t len);
+
+/** @brief Backs the default pool with pool_map instead of its static array
+    Must be called before pool_init, pool_init_sized, pool_init_aligned or pool_init_layout; the mapping lasts for the life of the process.
+    Will assert trap if initialization already completed.
+    @param flags POOL_MAP_* options
+    @param numa_node node to bind the heap to, or POOL_NUMA_ANY
+    @return bool true if the heap was mapped; false leaves the default pool on its static array
+*/
+bool pool_map_default_heap(unsigned flags, int numa_node);
+
+/** @brief Creates a pool in a new file mapped shared, so that its blocks and metadata outlive the process
+    The file holds a header recording the layout and the address the pool was mapped at, followed by a pool_create pool of len bytes.
+    Only one process may have the file attached at a time. Returns NULL where mmap is unavailable.
+    @param path file to create; fails if it exists
+    @param len bytes of the pool, up to MAX_POOL_SIZE
+    @param block_sizes list of block sizes, as in pool_create
+    @param block_size_count length of block_sizes
+    @return pool_t* Handle to the pool; NULL if the file cannot be created or the block sizes do not fit
+*/
+pool_t* pool_create_file(const char* path, size_t len, size_t* block_sizes, size_t block_size_count);
+
+/** @brief Maps a pool file from pool_create_file back in, with every block and counter as the last process left it
+    The file is mapped at the address recorded in its header when that address is free, so pointers stored in the blocks stay valid;
+    otherwise it is mapped elsewhere and the pool's own pointers are moved with it, in time proportional to the number of block sizes.
+    Compare the handle with the one the previous process had, or keep offsets from pool_root, to tell the two apart.
+    @param path file to attach
+    @param block_sizes block sizes the caller expects, in any order; NULL accepts those stored in the file
+    @param block_size_count length of block_sizes
+    @return pool_t* Handle to the pool; NULL if the file is not a pool file, was written by a build with a different layout or pool_index_t width,
+            or holds other block sizes. The file is left untouched then.
+*/
+pool_t* pool_attach(const char* path, size_t* block_sizes, size_t block_size_count);
+
+/** @brief Writes a file-backed pool back to its file and unmaps it; the handle and every block become invalid
+    In --enable-magazines builds the calling thread's caches are emptied first, and other threads must have called pool_magazine_flush.
+    @param pool pool from pool_create_file or pool_attach
+*/
+void pool_detach(pool_t* pool);
+
+/** @brief Records the block a restarted process should start from, such as the head of a cache's index
+    Will assert trap if pool is not file-backed or root does not lie in the pool
+    @param pool pool from pool_create_file or pool_attach
+    @param root block of the pool; NULL clears the root
+*/
+void pool_set_root(pool_t* pool, void* root);
+
+/** @brief Reads the root block of a file-backed pool, at its address in the current mapping
+    Will assert trap if pool is not file-backed
+    @param pool pool from pool_create_file or pool_attach
+    @return void* root block; NULL when none is set
+*/
+void* pool_root(pool_t* pool);
+
+/** @brief Elastic pool; each block size is a chain of slabs that grows when full. Needs --enable-elastic */
+typedef struct pool_elastic pool_elastic_t;
+
+/** @brief Source of slabs for an elastic pool */
+typedef struct {
+  void* (*acquire)(size_t len, void* ctx);            ///< Returns len bytes aligned to len, or NULL when no more memory is available
+  void (*release)(void* mem, size_t len, void* ctx);  ///< Takes back a slab from acquire
+  void* ctx;                                          ///< Passed to both callbacks
+} pool_slab_provider_t;
+
+/** @brief Running counters of one block size of an elastic pool */
+typedef struct {
+  size_t block_size;
+  size_t slabs;             ///< Slabs in the chain
+  size_t empty_slabs;       ///< Slabs with no live block, kept for reuse up to the hysteresis threshold
+  size_t capacity;          ///< Blocks in all slabs
+  size_t live;              ///< Blocks allocated
+  uint64_t slab_acquires;   ///< Slabs taken from the provider
+  uint64_t slab_releases;   ///< Slabs given back to the provider
+} pool_elastic_stats_t;
+
+/** @brief Creates an elastic pool that adds a slab to a block size when its slabs are full, instead of spilling into larger block sizes
+    A larger block size is only used when the provider has no more slabs. Fully empty slabs beyond max_empty_slabs per block size
+    go back to the provider. The pool's own bookkeeping takes one slab, from the same provider.
+    Without --enable-elastic this returns NULL, so that fixed-footprint builds never map memory.
+    @param block_sizes A list of block sizes to be allocated
+    @param block_size_count Length of the block_sizes list
+    @param slab_len Bytes per slab; a power of two from 4096 up to MAX_POOL_SIZE that holds at least one block of every size beside the
+           slab's own metadata
+    @param max_empty_slabs Empty slabs each block size keeps before returning more to the provider
+    @param provider Slab source; NULL maps slabs with pool_map
+    @return pool_elastic_t* Handle to the pool; NULL if the arguments are invalid, a block size does not fit a slab, or the provider has no memory
+*/
+pool_elastic_t* pool_elastic_create(size_t* block_sizes, size_t block_size_count, size_t slab_len, size_t max_empty_slabs, const pool_slab_provider_t* provider);
+
+/** @brief Allocates from an elastic pool; safe to call concurrently in --enable-thread-safe builds
+    @param pool elastic pool to allocate from
+    @param n number of bytes requested
+    @return void* Pointer to allocated area; NULL if n is larger than every block size or the provider has no more slabs
+*/
+void* pool_elastic_malloc(pool_elastic_t* pool, size_t n);
+
+/** @brief Frees memory allocated from an elastic pool
+    Will assert trap if ptr does not come from pool
+    @param pool elastic pool ptr was allocated from
+    @param ptr pointer to be freed; NULL is ignored
+*/
+void pool_elastic_free(pool_elastic_t* pool, void* ptr);
+
+/** @brief Reads the counters of every block size of an elastic pool, smallest first
+    @param pool elastic pool to read
+    @param classes list to fill in
+    @param max_classes length of classes
+    @return size_t number of block sizes; entries past max_classes are not written
+*/
+size_t pool_elastic_stats(pool_elastic_t* pool, pool_elastic_stats_t* classes, size_t max_classes);
+
+/** @brief Returns every slab of an elastic pool, live blocks included, to its provider
+    @param pool elastic pool to destroy; NULL is ignored
+*/
+void pool_elastic_destroy(pool_elastic_t* pool);
+
+/** @brief Memory allocator for a pool created with pool_create
+    Same contract as pool_malloc
+    @param pool pool to allocate from
+    @param n number of bytes requested
+    @return void* Pointer to allocated area; NULL if allocation failed
+*/
+void* pool_malloc_h(pool_t* pool, size_t n);
+
+/** @brief pool_malloc_bulk for a pool created with pool_create
+    @param pool pool to allocate from
+    @param n number of bytes requested per block
+    @param out list of count entries that receives the pointers
+    @param count number of blocks requested
+    @return size_t number of blocks allocated
+*/
+size_t pool_malloc_bulk_h(pool_t* pool, size_t n, void** out, size_t count);
+
+/** @brief pool_aligned_alloc for a pool created with pool_create
+    @param pool pool to allocate from
+    @param align required alignment; a power of two
+    @param n number of bytes requested
+    @return void* Pointer to allocated area; NULL if allocation failed
+*/
+void* pool_aligned_alloc_h(pool_t* pool, size_t align, size_t n);
+
+/** @brief pool_malloc_near for a pool created with pool_create
+    @param pool pool to allocate from
+    @param n number of bytes requested
+    @param hint any address inside a block of pool; NULL allocates like pool_malloc_h
+    @return void* Pointer to allocated area; NULL if allocation failed
+*/
+void* pool_malloc_near_h(pool_t* pool, size_t n, const void* hint);
+
+/** @brief pool_set_placement for a pool created with pool_create
+    @param pool pool to set the policy of
+    @param placement POOL_PLACE_FIRST_FIT or POOL_PLACE_NEXT_FIT
+    @return bool true if the policy was set
+*/
+bool pool_set_placement_h(pool_t* pool, pool_placement_t placement);
+
+/** @brief Frees memory allocated from a pool created with pool_create
+    Same contract as pool_free
+    @param pool pool ptr was allocated from
+    @param ptr pointer to be freed
+*/
+void pool_free_h(pool_t* pool, void* ptr);
+
+/** @brief Frees memory of known requested size allocated from a pool created with pool_create
+    Same contract as pool_free_sized
+    @param pool pool ptr was allocated from
+    @param ptr pointer to be freed
+    @param n number of bytes requested from pool_malloc_h for ptr
+*/
+void pool_free_sized_h(pool_t* pool, void* ptr, size_t n);
+
+/** @brief pool_free_bulk for a pool created with pool_create
+    @param pool pool the pointers were allocated from
+    @param ptrs pointers to be freed; NULL entries are skipped
+    @param count length of ptrs
+*/
+void pool_free_bulk_h(pool_t* pool, void** ptrs, size_t count);
+
+/** @brief pool_realloc for a pool created with pool_create
+    Same contract as pool_realloc
+    @param pool pool ptr was allocated from
+    @param ptr block to resize; NULL allocates like pool_malloc_h
+    @param n number of bytes requested; 0 frees ptr like pool_free_h
+    @return void* Pointer to the resized block; NULL if the block could not be resized, in which case ptr is left as it was
+*/
+void* pool_realloc_h(pool_t* pool, void* ptr, size_t n);
+
+/** @brief pool_usable_size for a pool created with pool_create
+    @param pool pool ptr was allocated from
+    @param ptr allocated block
+    @return size_t usable bytes; 0 if ptr is NULL or not the start of a block
+*/
+size_t pool_usable_size_h(pool_t* pool, void* ptr);
+
+/** @brief pool_reset for a pool created with pool_create
+    @param pool pool to reset
+*/
+void pool_reset_h(pool_t* pool);
+
+/** @brief pool_reset_region for a pool created with pool_create
+    @param pool pool to reset
+    @param region index of the region in pool_stats order
+    @return bool true if the region was reset; false if there is no such region
+*/
+bool pool_reset_region_h(pool_t* pool, size_t region);
+
+/** @brief pool_mark_size for a pool created with pool_create
+    @param pool pool to mark
+    @return size_t bytes of the buffer pool_mark_h needs
+*/
+size_t pool_mark_size_h(pool_t* pool);
+
+/** @brief pool_mark for a pool created with pool_create
+    @param pool pool to mark
+    @param mark buffer of pool_mark_size_h(pool) bytes
+*/
+void pool_mark_h(pool_t* pool, void* mark);
+
+/** @brief pool_release for a pool created with pool_create
+    @param pool pool to roll back
+    @param mark buffer filled by pool_mark_h for this pool
+*/
+void pool_release_h(pool_t* pool, const void* mark);
+
+/** @brief pool_destroy for a pool created with pool_create; call it before the pool's memory is freed or reused
+    @param pool pool to destroy; the handle and every block become invalid
+*/
+void pool_destroy_h(pool_t* pool);
+
+/** @brief Per-thread slot cache counters, summed over all threads */
+typedef struct {
+  uint64_t alloc_hits;      ///< pool_malloc calls served from a thread's cache
+  uint64_t alloc_refills;   ///< pool_malloc calls that refilled a thread's cache from the occupation maps
+  uint64_t free_hits;       ///< pool_free calls absorbed by a thread's cache
+  uint64_t free_flushes;    ///< Batches returned to the occupation maps because a thread's cache was full
+} pool_magazine_stats_t;
+
+/** @brief Returns every slot held in the calling thread's caches, for every pool, to the occupation maps
+    Runs automatically on thread exit. A pool must outlive every thread that used it, or those threads must call this before it goes away.
+    A no-op unless built with --enable-magazines.
+*/
+void pool_magazine_flush(void);
+
+/** @brief Reads the per-thread slot cache counters of the default pool
+    All zero unless built with --enable-magazines.
+    @param stats counters to fill in
+*/
+void pool_magazine_stats(pool_magazine_stats_t* stats);
+
+/** @brief Reads the per-thread slot cache counters of a pool created with pool_create
+    @param pool pool to read the counters of
+    @param stats counters to fill in
+*/
+void pool_magazine_stats_h(pool_t* pool, pool_magazine_stats_t* stats);
+
+/** @brief Lets pool_malloc split a free slot of a larger block size into sub-slots when the block size that fits a request is full
+    Instead of spilling a small request into a whole larger slot, the slot is cut into as many sub-slots of the full block size as
+    it holds (up to 64), tracked in a side table of POOL_SPLIT_SLOTS entries (16 by default). Later requests of that block size take
+    the split slot's free sub-slots first; when the last sub-slot is freed, the slot goes back to its region whole. Only slots that
+    hold at least two sub-slots are split, and requests spill as before when the table is full. pool_malloc_bulk and aligned requests
+    above 1 never split. Sub-slots are freed, resized and measured like any block.
+    Splitting is off until enabled; turning it off keeps the slots already split until their sub-slots are freed.
+    Will assert trap if pool is not initialized
+    @param enable true to split slots, false to spill whole slots again
+    @return bool true if the setting took effect; false unless built with --enable-slot-splitting
+*/
+bool pool_set_splitting(bool enable);
+
+/** @brief pool_set_splitting for a pool created with pool_create
+    @param pool pool to set the policy of
+    @param enable true to split slots
+    @return bool true if the setting took effect
+*/
+bool pool_set_splitting_h(pool_t* pool, bool enable);
+
+/** @brief Slot splitting counters; a split slot counts as one live block of its own region in pool_stats */
+typedef struct {
+  uint64_t splits;          ///< Slots of a larger block size split into sub-slots
+  uint64_t merges;          ///< Split slots returned whole to their region once their last sub-slot was freed
+  uint64_t borrows;         ///< Allocations served from a sub-slot instead of spilling into a whole larger slot
+  uint64_t table_full;      ///< Allocations that could not split a slot because every entry of the side table was in use
+  uint64_t split_slots;     ///< Slots split right now
+  uint64_t sub_slots;       ///< Sub-slots of the slots split right now
+  uint64_t sub_live;        ///< Sub-slots in use right now
+  uint64_t idle_bytes;      ///< Bytes of the slots split right now outside live sub-slots: free sub-slots and the tail past the last one
+} pool_split_stats_t;
+
+/** @brief Reads the slot splitting counters of the default pool
+    All zero unless built with --enable-slot-splitting.
+    Will assert trap if pool is not initialized
+    @param stats counters to fill in
+*/
+void pool_split_stats(pool_split_stats_t* stats);
+
+/** @brief Reads the slot splitting counters of a pool created with pool_create
+    @param pool pool to read the counters of
+    @param stats counters to fill in
+*/
+void pool_split_stats_h(pool_t* pool, pool_split_stats_t* stats);
+
+/** @brief One bucket of the requested-size histogram */
+typedef struct {
+  size_t size;      ///< Largest request size in the bucket; a block of this size fits every request in it
+  uint64_t count;   ///< pool_malloc/pool_malloc_h calls that requested a size in the bucket
+} pool_histogram_entry_t;
+
+/** @brief Reads the requested-size histogram, shared by every pool, in ascending size order
+    Sizes up to 1024 B have a bucket each; larger sizes are grouped 16 buckets per power of two. Empty buckets are skipped.
+    Nothing is recorded unless built with --enable-histogram.
+    @param entries list to fill in
+    @param max_entries length of entries
+    @return size_t number of non-empty buckets; entries past max_entries are not written
+*/
+size_t pool_histogram(pool_histogram_entry_t* entries, size_t max_entries);
+
+/** @brief Clears the requested-size histogram */
+void pool_histogram_reset(void);
+
+/** @brief Writes the requested-size histogram to a text file with one "size count" line per non-empty bucket, for the pool_tune tool
+    @param path file to create or overwrite
+    @return bool true if the file was written; false on I/O errors or unless built with --enable-histogram
+*/
+bool pool_histogram_save(const char* path);
+
+/** @brief Kind of a traced event */
+typedef enum {
+  POOL_TRACE_MALLOC = 1,  ///< A block was handed out, or ptr is 0 when the allocation failed
+  POOL_TRACE_FREE = 2     ///< A block was returned
+} pool_trace_op_t;
+
+#define POOL_TRACE_CLOCK_NS 0     ///< Timestamps are CLOCK_MONOTONIC nanoseconds
+#define POOL_TRACE_CLOCK_TSC 1    ///< Timestamps are rdtsc cycles
+#define POOL_TRACE_MAGIC UINT64_C(0x4543415254504254)   ///< "TBPTRACE"
+#define POOL_TRACE_VERSION 1
+
+/** @brief One allocation or free, as recorded with --enable-tracing */
+typedef struct {
+  uint64_t timestamp;     ///< Clock of the trace header; comparable across threads on CPUs with an invariant TSC
+  uint64_t pool;          ///< Address of the pool handle
+  uint64_t ptr;           ///< Block address; 0 for a failed allocation
+  uint32_t size;          ///< Requested bytes of an allocation; 0 for frees
+  uint32_t slot;          ///< Slot number within the region; for a sub-slot of a split slot, the number of the split slot
+  uint16_t thread;        ///< Ring of the calling thread, numbered in order of first use
+  uint8_t op;             ///< pool_trace_op_t
+  uint8_t region;         ///< Block-size region, smallest first; for a failed allocation, the smallest that fits; for a sub-slot, the region of its split slot
+  uint32_t reserved;
+} pool_trace_event_t;
+
+/** @brief Start of a file written by pool_trace_dump; num_events pool_trace_event_t records follow in timestamp order */
+typedef struct {
+  uint64_t magic;         ///< POOL_TRACE_MAGIC
+  uint32_t version;       ///< POOL_TRACE_VERSION
+  uint32_t event_len;     ///< sizeof(pool_trace_event_t)
+  uint32_t clock;         ///< POOL_TRACE_CLOCK_NS or POOL_TRACE_CLOCK_TSC
+  uint32_t reserved;
+  uint64_t num_events;
+  uint64_t dropped;       ///< Events lost to full rings or to threads past the ring limit
+} pool_trace_header_t;
+
+/** @brief Reads the traced events of every thread, oldest first
+    Built with --enable-tracing, each allocation and free of every pool is appended to a ring of the calling thread, without locks.
+    A ring keeps its thread's last POOL_TRACE_EVENTS (4096) events, and POOL_TRACE_THREADS (32) threads get one; override both through CPPFLAGS.
+    Without --enable-tracing nothing is recorded and the allocation paths carry no tracing code.
+    @param events list to fill in
+    @param max_events length of events
+    @return size_t number of events held; events past max_events are not written
+*/
+size_t pool_trace_read(pool_trace_event_t* events, size_t max_events);
+
+/** @brief Drops every traced event recorded so far */
+void pool_trace_reset(void);
+
+/** @brief Writes the traced events to a binary file, a pool_trace_header_t followed by the events, for the pool_replay tool
+    @param path file to create or overwrite
+    @return bool true if the file was written; false on I/O errors or unless built with --enable-tracing
+*/
+bool pool_trace_dump(const char* path);
+
+/** @brief Running counters of one block-size region
+    A request is counted against the smallest block size that fits it, whichever region serves it.
+*/
+typedef struct {
+  size_t block_size;      ///< Block size of the region in bytes, as given at initialization
+  size_t capacity;        ///< Number of blocks in the region
+  size_t alignment;       ///< Largest power of two every block address of the region is a multiple of
+  size_t padding;         ///< Bytes spent on alignment: spacing between blocks plus the gap in front of the region
+  uint64_t live;          ///< Blocks handed out and not yet freed
+  uint64_t high_water;    ///< Highest live count seen
+  uint64_t allocs;        ///< Blocks handed out by pool_malloc/pool_malloc_bulk
+  uint64_t frees;         ///< Blocks returned by pool_free/pool_free_sized/pool_free_bulk
+  uint64_t spills;        ///< Requests that fit this block size but were served by a larger one because the region was full
+  uint64_t failures;      ///< Requests that fit this block size but found no free block in it or any larger region
+} pool_region_stats_t;
+
+/** @brief Reads the running counters of every block-size region of the default pool, smallest block size first
+    Counters are kept up to date by every allocation and free, so reading them costs one copy per region.
+    In --enable-magazines builds, each thread keeps its counts for cached block sizes locally and adds them to the
+    pool's totals on cache refills and flushes, after every 1024 cached operations, and when that thread reads the stats;
+    live and high_water may lag other threads by that much.
+    Will assert trap if pool is not initialized
+    @param regions list to fill in
+    @param max_regions length of regions
+    @return size_t number of block-size regions in the pool; regions past max_regions are not written
+*/
+size_t pool_stats(pool_region_stats_t* regions, size_t max_regions);
+
+/** @brief pool_stats for a pool created with pool_create
+    @param pool pool to read the counters of
+    @param regions list to fill in
+    @param max_regions length of regions
+    @return size_t number of block-size regions in the pool
+*/
+size_t pool_stats_h(pool_t* pool, pool_region_stats_t* regions, size_t max_regions);
+
 // Helper functions
 /** @brief Attempts to find a free slot within a given block-size region
-    @param b_addr base address of the block-size region
-    @param blk_free_loc pointer to a uint16_t variable that can store the first slot number that is free in the block-size region's occupation map
+    The region's summary map (one bit per full occupation map word) picks the first occupation map word with a free slot, and count-trailing-zeros on that word picks the slot.
+    When built with --enable-simd, runs of full summary words are skipped with SSE2 or AVX2 compares, depending on the target flags.
+    @param b_addr base address of the block-size region; must be 8-byte aligned
+    @param blk_free_loc pointer to a pool_index_t variable that can store the first slot number that is free in the block-size region's occupation map
     @param block_size_idx index of the block_sizes_list to indicate which block-size region to search in
     @return bool true if free slice found; false otherwise
 */
-bool findFreeSlot(uint8_t* b_addr, uint16_t* blk_free_loc, uint8_t block_size_idx);
+bool findFreeSlot(uint8_t* b_addr, pool_index_t* blk_free_loc, uint8_t block_size_idx);
 
 /** @brief In-place insertion sort of a given list
     @param a Pointer to array to be sorted
     @param size size of the array
 */
-void insertionSort(uint16_t* a,const uint8_t size);
+void insertionSort(pool_index_t* a,const uint8_t size);
 
-/** @brief Diagnostic function that will make a detailed print of the heap pool regions. This function will also display each block-size region's occupation map and capacity status.
+/** @brief Diagnostic function that will make a detailed print of the heap pool regions. This function will also display each block-size region's occupation map and its pool_stats counters.
+    Prints every occupation map bit; use pool_stats for monitoring.
 */
 void printMemory();
 
+/** @brief printMemory for a pool created with pool_create
+    @param pool pool to print
+*/
+void printMemory_h(pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* POOL_ALLOC_H_ */
@@ -0,0 +1,177 @@
+/**
+ * @file pool_alloc.hpp
+ * @author Frank Gu
+ * @date 4 Feb 2019
+ * @brief C++ adapters over the tunable block pool allocator: a standard Allocator and a std::pmr::memory_resource
+ */
+
+#ifndef POOL_ALLOC_HPP_
+#define POOL_ALLOC_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#if (__cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define POOL_ALLOC_HAS_PMR 1
+#endif
+#endif
+
+#include "pool_alloc.h"
+
+namespace pool_alloc {
+
+/** @brief Bytes to ask the pool for; zero-length requests still get a block so that every allocation has a distinct address */
+inline std::size_t requestBytes(std::size_t bytes) noexcept {
+  return (bytes > 0) ? bytes : 1;
+}
+
+/** @brief Allocates from pool, or the default pool when pool is nullptr; nullptr when no region that fits is aligned enough or has room */
+inline void* allocateBytes(pool_t* pool, std::size_t bytes, std::size_t alignment) noexcept {
+  return (pool != nullptr) ? pool_aligned_alloc_h(pool, alignment, requestBytes(bytes)) : pool_aligned_alloc(alignment, requestBytes(bytes));
+}
+
+/** @brief Frees a block from allocateBytes, skipping the pointer-to-region lookup when the block came from the size class of bytes */
+inline void deallocateBytes(pool_t* pool, void* ptr, std::size_t bytes) noexcept {
+  if(pool != nullptr) {
+    pool_free_sized_h(pool, ptr, requestBytes(bytes));
+  } else {
+    pool_free_sized(ptr, requestBytes(bytes));
+  }
+}
+
+/** @brief Standard Allocator over a pool
+    allocate(n) takes the smallest block size that fits n objects in a region aligned to alignof(T), and deallocate uses the sized free.
+    Allocations larger than the largest block size, or beyond what the pool has left, throw std::bad_alloc; a pool whose regions
+    are not aligned enough for T needs pool_create_aligned. Copies share the pool and compare equal.
+    @tparam T value type
+*/
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  /** @brief Allocator over the default pool, which must be initialized before the first allocation */
+  PoolAllocator() noexcept : pool_(nullptr) {}
+
+  /** @brief Allocator over a pool created with pool_create; the pool must outlive every container using it */
+  explicit PoolAllocator(pool_t* pool) noexcept : pool_(pool) {}
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& other) noexcept : pool_(other.pool()) {}
+
+  T* allocate(std::size_t n) {
+    if(n > max_size()) {
+      throw std::bad_array_new_length();
+    }
+    void* ptr = allocateBytes(pool_, n * sizeof(T), alignof(T));
+    if(ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    deallocateBytes(pool_, ptr, n * sizeof(T));
+  }
+
+  std::size_t max_size() const noexcept {
+    return MAX_POOL_SIZE / sizeof(T);
+  }
+
+  /** @brief Pool this allocator draws from; nullptr for the default pool */
+  pool_t* pool() const noexcept {
+    return pool_;
+  }
+
+ private:
+  pool_t* pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+  return a.pool() == b.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) noexcept {
+  return a.pool() != b.pool();
+}
+
+/** @brief Marks a pool when constructed and releases it back to that mark when destroyed, freeing every block allocated in between
+    Scopes nest like the phases of a request; same conditions as pool_mark/pool_release.
+*/
+class PoolScope {
+ public:
+  /** @brief Scope over pool, or the default pool when pool is nullptr; the mark buffer comes from operator new */
+  explicit PoolScope(pool_t* pool = nullptr)
+      : pool_(pool), mark_(new unsigned char[(pool != nullptr) ? pool_mark_size_h(pool) : pool_mark_size()]) {
+    if(pool_ != nullptr) {
+      pool_mark_h(pool_, mark_.get());
+    } else {
+      pool_mark(mark_.get());
+    }
+  }
+
+  ~PoolScope() {
+    if(pool_ != nullptr) {
+      pool_release_h(pool_, mark_.get());
+    } else {
+      pool_release(mark_.get());
+    }
+  }
+
+  PoolScope(const PoolScope&) = delete;
+  PoolScope& operator=(const PoolScope&) = delete;
+
+ private:
+  pool_t* pool_;
+  std::unique_ptr<unsigned char[]> mark_;
+};
+
+#ifdef POOL_ALLOC_HAS_PMR
+/** @brief std::pmr::memory_resource over a pool, for pmr containers
+    Same block selection and failure behaviour as PoolAllocator: requests larger than the largest block size, or beyond what the pool
+    has left, throw std::bad_alloc. Two resources are equal when they share a pool.
+*/
+class PoolResource : public std::pmr::memory_resource {
+ public:
+  /** @brief Resource over the default pool, which must be initialized before the first allocation */
+  PoolResource() noexcept : pool_(nullptr) {}
+
+  /** @brief Resource over a pool created with pool_create; the pool must outlive every container using it */
+  explicit PoolResource(pool_t* pool) noexcept : pool_(pool) {}
+
+  /** @brief Pool this resource draws from; nullptr for the default pool */
+  pool_t* pool() const noexcept {
+    return pool_;
+  }
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    void* ptr = allocateBytes(pool_, bytes, alignment);
+    if(ptr == nullptr) {
+      throw std::bad_alloc();
+    }
+    return ptr;
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+    (void)alignment;
+    deallocateBytes(pool_, ptr, bytes);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    const PoolResource* pool_resource = dynamic_cast<const PoolResource*>(&other);
+    return (pool_resource != nullptr) && (pool_resource->pool_ == pool_);
+  }
+
+  pool_t* pool_;
+};
+#endif
+
+}  // namespace pool_alloc
+
+#endif /* POOL_ALLOC_HPP_ */
@@ -5,230 +5,3003 @@
  *      Author: Frank Gu
  */
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 #include <limits.h>
 
+#if defined(POOL_MAGAZINES) || (defined(POOL_ELASTIC) && defined(POOL_THREAD_SAFE))
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef POOL_TRACE
+#include <stdlib.h>
+#include <time.h>
+#endif
+
+#if defined(POOL_USE_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(POOL_USE_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "include/pool_alloc.h"
 
-static uint8_t g_pool_heap[MAX_HEAP_SIZE];
-static size_t num_block_size;
+// The installed header takes the index width from pool_alloc_config.h; both come from the same configure run
+#if (POOL_INDEX_BITS == 32) != defined(POOL_LARGE)
+#error "pool_alloc_config.h and config.h disagree on --enable-large-pools; rerun configure"
+#endif
+
+// Occupation maps are scanned one 64-bit word at a time; each summary bit covers one full word
+#define OCC_WORD_BITS 64
+#define OCC_SUMMARY_SPAN (OCC_WORD_BITS * OCC_WORD_BITS)
+#define OCC_WORD_FULL UINT64_MAX
+// Occupation and summary map accessors; thread-safe builds claim and release bits with atomic read-modify-writes
+#ifdef POOL_THREAD_SAFE
+#define OCC_LOAD(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define OCC_FETCH_OR(p, mask) __atomic_fetch_or((p), (mask), __ATOMIC_SEQ_CST)
+#define OCC_FETCH_AND(p, mask) __atomic_fetch_and((p), (mask), __ATOMIC_SEQ_CST)
+#define HINT_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define HINT_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define STAT_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STAT_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#else
+#define OCC_LOAD(p) (*(p))
+#define OCC_FETCH_OR(p, mask) occFetchOr((p), (mask))
+#define OCC_FETCH_AND(p, mask) occFetchAnd((p), (mask))
+#define HINT_LOAD(p) (*(p))
+#define HINT_STORE(p, v) (*(p) = (v))
+#define STAT_LOAD(p) (*(p))
+#define STAT_ADD(p, v) (*(p) += (v))
+#endif
+
+#define ALIGN_WORD(x) (((x) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1))
+
+// Size-class lookup: exact entries up to CLASS_DIRECT_MAX bytes, then CLASS_LOG_SUBBUCKETS buckets per power of two
+#define CLASS_DIRECT_MAX 256
+#define CLASS_LOG_MIN 8       // log2(CLASS_DIRECT_MAX)
+#ifdef POOL_LARGE
+#define CLASS_LOG_MAX 32      // log2(MAX_POOL_SIZE + 1)
+#else
+#define CLASS_LOG_MAX 16      // log2(MAX_POOL_SIZE)
+#endif
+#define CLASS_LOG_SUBBUCKET_BITS 2
+#define CLASS_LOG_SUBBUCKETS (1 << CLASS_LOG_SUBBUCKET_BITS)
+#define CLASS_LOOKUP_ENTRIES (CLASS_DIRECT_MAX + 1 + (CLASS_LOG_MAX - CLASS_LOG_MIN) * CLASS_LOG_SUBBUCKETS)
+
+// Slots claimed per bitmap pass by pool_malloc_bulk
+#define BULK_CHUNK 64
+
+// Occupation map words pool_malloc_near searches on each side of the hint's word before falling back to the regular search
+#define NEAR_SEARCH_WORDS 8
+
+// pool_map: huge page mappings are sized and aligned for 2 MiB pages, and nodes up to MAP_MAX_NUMA_NODES - 1 can be bound
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define MAP_MAX_NUMA_NODES 1024
+#ifndef MPOL_BIND
+#define MPOL_BIND 2           // From linux/mempolicy.h, so that numaif.h from libnuma is not needed
+#endif
+
+// File-backed pools: a header in front of the pool records the layout and the address its pointers are valid for
+#define POOL_FILE_MAGIC UINT64_C(0x314c4f4f50504254)   // "TBPPOOL1"
+#define POOL_FILE_VERSION 1
+#define POOL_FILE_HEADER_LEN 64
+
+// Region lookup: one entry per 2^REGION_LOOKUP_SHIFT bytes of heap
+#ifdef POOL_LARGE
+#define REGION_LOOKUP_SHIFT 12
+#else
+#define REGION_LOOKUP_SHIFT 8
+#endif
+
+#ifdef POOL_SPLIT
+#ifdef POOL_THREAD_SAFE
+#error "Slot splitting is not available in thread-safe builds"
+#endif
+// Entries of each pool's split table: slots of a larger block size cut into sub-slots of a smaller one
+#ifndef POOL_SPLIT_SLOTS
+#define POOL_SPLIT_SLOTS 16
+#endif
+
+typedef struct {
+  uint64_t used;                  // One bit per sub-slot in use; 0 when the entry is free
+  pool_index_t slot;              // Slot that was split, in region
+  uint8_t region;
+  uint8_t sub_region;             // Region whose block size the sub-slots have
+  uint8_t sub_count;
+} split_slot_t;
+#endif
+
+// Pool instance; lives at the start of the memory handed to pool_create, followed by its metadata and regions
+struct pool {
+  uint8_t* heap_start;
+  size_t heap_len;
+  size_t num_block_size;
+
+  // Convenience address holders
+  uint8_t* class_lookup;
+  uint8_t* region_lookup;
+  pool_index_t* block_summary_hint;
+  pool_index_t* block_cursor;             // Occupation map word of each region's last claim, where next-fit searches start
+  uint64_t** block_summary_addr;
+  pool_region_stats_t* region_stats;
+  pool_index_t* block_sizes_list;
+  pool_index_t* block_offset_list;
+  uint8_t** block_base_addr;
+  uint8_t* alloc_end_addr;
+  pool_placement_t placement;
+
+  pool_magazine_stats_t magazine_stats;   // Per-thread cache counters folded in from every thread; zero without magazines
+#ifdef POOL_MAGAZINES
+  uint64_t id;                            // Creation number; caches of an earlier pool at the same address do not match it
+#endif
+#ifdef POOL_SPLIT
+  split_slot_t* splits;
+  bool splitting;
+  pool_split_stats_t split_stats;         // Running counters; the gauges derived from the table are filled in on read
+#endif
+};
+
+// Header of a file-backed pool, at the start of the file; the pool follows at POOL_FILE_HEADER_LEN
+typedef struct {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t num_block_size;
+  uint64_t file_len;
+  uint64_t base;                  // Address the file was mapped at when the pool's pointers were last valid
+  uint64_t root;                  // Offset of the root block from base; 0 when none is set
+  uint16_t pool_len;              // sizeof(pool_t), sizeof(pool_index_t) and sizeof(pool_region_stats_t) of the
+  uint16_t index_len;             // build that created the file; builds that differ cannot attach it
+  uint16_t stats_len;
+  uint16_t region_lookup_shift;
+} pool_file_header_t;
+
+// Default instance behind pool_init/pool_malloc/pool_free
+static uint8_t g_pool_heap[MAX_HEAP_SIZE] __attribute__((aligned(sizeof(uint64_t))));
+static uint8_t* g_heap_mem = g_pool_heap;   // Replaced by a mapping through pool_map_default_heap
+static size_t g_heap_len = MAX_HEAP_SIZE;
+static pool_t* g_default_pool;
 static bool f_pool_init = false;
 
-// Convenience address holders
-static uint16_t* block_sizes_list;
-static uint16_t* block_offset_list;
-static uint8_t** block_base_addr;
-static uint8_t* alloc_end_addr;
+#ifdef POOL_HISTOGRAM
+// Requested-size histogram: exact buckets up to HIST_DIRECT_MAX bytes, then HIST_LOG_SUBBUCKETS buckets per power of two
+#define HIST_DIRECT_MAX 1024
+#define HIST_LOG_MIN 10       // log2(HIST_DIRECT_MAX)
+#define HIST_LOG_SUBBUCKET_BITS 4
+#define HIST_LOG_SUBBUCKETS (1 << HIST_LOG_SUBBUCKET_BITS)
+#define HIST_BUCKETS (HIST_DIRECT_MAX + 1 + (CLASS_LOG_MAX - HIST_LOG_MIN) * HIST_LOG_SUBBUCKETS)
+
+// Shared by every pool; counted with relaxed atomics in thread-safe builds
+static uint64_t g_size_histogram[HIST_BUCKETS];
+#endif
+
+#ifdef POOL_TRACE
+// Event rings: one per thread, claimed on first use and kept after the thread exits so its events can still be dumped
+#ifndef POOL_TRACE_THREADS
+#define POOL_TRACE_THREADS 32
+#endif
+#ifndef POOL_TRACE_EVENTS
+#define POOL_TRACE_EVENTS 4096    // Per thread; older events are overwritten
+#endif
+
+typedef struct {
+  uint64_t head;                  // Events ever written; only the owning thread writes it
+  uint64_t start;                 // First event still to be read, moved by pool_trace_reset
+  pool_trace_event_t events[POOL_TRACE_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t g_trace_rings[POOL_TRACE_THREADS];
+static uint32_t g_trace_num_rings;
+static uint64_t g_trace_unringed;    // Events of threads beyond POOL_TRACE_THREADS
+static __thread trace_ring_t* t_trace_ring;
+#endif
+
+#ifdef POOL_THREAD_SAFE
+// Occupation map word each thread starts its search at; moved on contention
+static __thread pool_index_t t_scan_start;
+static __thread uint32_t t_scan_seed;
+#endif
+
+#ifdef POOL_MAGAZINES
+// Per-thread slot caches for the smallest block sizes; refilled and flushed MAGAZINE_BATCH slots at a time
+#ifndef POOL_MAGAZINE_SIZE
+#define POOL_MAGAZINE_SIZE 32
+#endif
+#ifndef POOL_MAGAZINE_CLASSES
+#define POOL_MAGAZINE_CLASSES 16
+#endif
+// Pools a thread keeps caches for at once; using one more evicts the oldest
+#ifndef POOL_MAGAZINE_POOLS
+#define POOL_MAGAZINE_POOLS 4
+#endif
+#define MAGAZINE_BATCH (POOL_MAGAZINE_SIZE / 2)
+
+// Cache hits between two folds of a thread's counters into its pool's totals
+#define MAGAZINE_FOLD_OPS 1024
+
+typedef struct {
+  uint16_t count;
+  uint64_t allocs;                // Slots handed out and returned through this cache, not yet
+  uint64_t frees;                 // folded into the region's counters
+  uint8_t* slots[POOL_MAGAZINE_SIZE];
+} magazine_t;
+
+typedef struct {
+  pool_t* pool;                   // Pool the caches hold slots of; NULL when unused
+  uint64_t pool_id;               // That pool's id when the set was taken
+  pool_magazine_stats_t stats;    // Counts not yet folded into the pool's totals
+  uint16_t unfolded_ops;          // Cache hits since the counters were last folded
+  magazine_t magazines[POOL_MAGAZINE_CLASSES];
+} magazine_set_t;
+
+static __thread magazine_set_t t_magazine_sets[POOL_MAGAZINE_POOLS];
+static uint64_t g_pool_ids;       // Last id handed to a pool; ids start at 1, and 0 marks a destroyed pool
+static __thread uint8_t t_magazine_evict;
+static __thread bool t_magazine_registered;
+static pthread_key_t g_magazine_key;
+static pthread_once_t g_magazine_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+#ifdef POOL_ELASTIC
+// Elastic pools: each size class is a chain of slab_len-aligned slabs, each holding a one-block-size pool
+typedef struct pool_slab {
+  pool_elastic_t* owner;          // Checked on free, so that pointers from elsewhere are caught
+  struct pool_slab* next;
+  pool_t* pool;
+  size_t live;
+  size_t capacity;
+  uint8_t class_idx;
+} pool_slab_t;
+
+typedef struct {
+  size_t block_size;
+  pool_slab_t* slabs;
+  pool_slab_t* hint;              // Slab that last had a free block
+  size_t num_slabs;
+  size_t empty_slabs;             // Slabs with no live block, kept up to max_empty_slabs
+  size_t capacity;
+  size_t live;
+  uint64_t acquires;
+  uint64_t releases;
+#ifdef POOL_THREAD_SAFE
+  pthread_mutex_t lock;           // Guards the chain and counters; the slab pools need no lock of their own
+#endif
+} elastic_class_t;
+
+struct pool_elastic {
+  size_t slab_len;
+  size_t max_empty_slabs;
+  pool_slab_provider_t provider;
+  size_t num_classes;
+  elastic_class_t classes[];
+};
+
+#define SLAB_HEADER_LEN ALIGN_WORD(sizeof(pool_slab_t))
+#ifdef POOL_THREAD_SAFE
+#define ELASTIC_LOCK(cls) pthread_mutex_lock(&(cls)->lock)
+#define ELASTIC_UNLOCK(cls) pthread_mutex_unlock(&(cls)->lock)
+#else
+#define ELASTIC_LOCK(cls) ((void)(cls))
+#define ELASTIC_UNLOCK(cls) ((void)(cls))
+#endif
+#define MIN_SLAB_LEN 4096
+#endif
+
+static pool_t* createPool(void* mem, size_t len, size_t* block_sizes, const size_t* alignments, const size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities);
+static size_t resolveAlignment(size_t block_size, size_t alignment);
+static inline void* claimBlock(pool_t* pool, size_t n, size_t min_align, uint8_t end);
+static uint8_t slotRegion(const pool_t* pool, uint8_t* ptr);
+static pool_file_header_t* fileHeader(pool_t* pool);
+static bool validPoolFile(const pool_file_header_t* header, const pool_t* pool);
+static void rebasePool(pool_t* pool, uint8_t* old_base, uint8_t* new_base);
+static size_t regionGrowthCost(pool_index_t block_count, pool_index_t block_size);
+static size_t regionBytes(size_t block_count, pool_index_t block_size);
+static size_t growRegionsEvenly(const pool_index_t* block_sizes_list, pool_index_t* block_counts, size_t num_block_size, size_t available_bytes);
+static bool sizeRegions(const pool_index_t* block_sizes_list, const size_t* targets, size_t num_block_size, pool_sizing_t sizing, size_t available_bytes, pool_index_t* block_counts);
+static void buildClassLookup(pool_t* pool);
+static uint8_t sizeClassIndex(const pool_t* pool, size_t n);
+static void buildRegionLookup(pool_t* pool);
+static uint8_t regionIndex(const pool_t* pool, uint8_t* ptr);
+
+/*
+ * First slot of block-size region i; regions are told apart by their slots, since the split layout keeps
+ * the occupation maps elsewhere.
+ */
+static inline uint8_t* slotBase(const pool_t* pool, uint8_t i) {
+  return pool->block_base_addr[i] + pool->block_offset_list[i];
+}
+
+/*
+ * Word span of the occupation map of block-size region i.
+ */
+static inline pool_index_t mapWords(const pool_t* pool, uint8_t i) {
+  return (pool->region_stats[i].capacity + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+}
+static void clearRegionMaps(pool_t* pool, uint8_t i);
+static void resetRegion(pool_t* pool, uint8_t i);
+static bool freeSlot(pool_t* pool, uint8_t i, uint8_t* ptr);
+static void releaseWordSlots(pool_t* pool, uint8_t i, pool_index_t occ_map_word_offset, uint64_t slot_mask);
+static void releaseSlot(pool_t* pool, uint8_t i, uint8_t* ptr);
+static pool_index_t claimSlots(pool_t* pool, uint8_t* b_addr, pool_index_t* blk_free_locs, pool_index_t max_slots, uint8_t block_size_idx);
+static pool_index_t claimWordSlots(uint64_t* occ_map, uint64_t* summary, pool_index_t om_word_idx, pool_index_t* blk_free_locs, pool_index_t max_slots);
+static pool_index_t claimSlotsNextFit(pool_t* pool, uint8_t i, pool_index_t* blk_free_locs, pool_index_t max_slots);
+static bool claimNearSlot(pool_t* pool, uint8_t i, pool_index_t target, pool_index_t* blk_free_loc);
+#ifdef POOL_ELASTIC
+static void* elasticClassAlloc(pool_elastic_t* pool, size_t c);
+static pool_slab_t* elasticSlabAcquire(pool_elastic_t* pool, elastic_class_t* cls, size_t c);
+static void elasticSlabRelease(pool_elastic_t* pool, elastic_class_t* cls, pool_slab_t* slab);
+static void* mapSlab(size_t len, void* ctx);
+static void unmapSlab(void* mem, size_t len, void* ctx);
+#endif
+#ifdef POOL_THREAD_SAFE
+static void markWordFull(uint64_t* occ_map_word, uint64_t* summary_word, uint64_t summary_mask);
+static pool_index_t nextScanStart(void);
+#else
+static inline uint64_t occFetchOr(uint64_t* p, uint64_t mask) {
+  uint64_t old = *p;
+  *p = old | mask;
+  return old;
+}
+
+static inline uint64_t occFetchAnd(uint64_t* p, uint64_t mask) {
+  uint64_t old = *p;
+  *p = old & mask;
+  return old;
+}
+#endif
+#ifdef POOL_MAGAZINES
+static magazine_set_t* magazineSet(pool_t* pool);
+static uint8_t* magazinePop(pool_t* pool, uint8_t i);
+static void magazinePush(pool_t* pool, uint8_t i, uint8_t* ptr);
+static void magazineFlushSet(magazine_set_t* set);
+static void magazineDropSet(magazine_set_t* set);
+static void magazineRegister(void);
+static void magazineFoldStats(magazine_set_t* set);
+static void magazineFlushPool(pool_t* pool);
+#endif
+#ifdef POOL_SPLIT
+static uint8_t* splitClaim(pool_t* pool, uint8_t fit, uint8_t end, split_slot_t** parent);
+static split_slot_t* splitFind(pool_t* pool, uint8_t* ptr, size_t* sub);
+static bool splitRelease(pool_t* pool, uint8_t* ptr);
+#endif
+#ifndef POOL_THREAD_SAFE
+static pool_index_t skipFullWords(const uint64_t* map, pool_index_t map_words);
+#endif
+
+/*
+ * Counts count blocks handed out by region stats, raising its high-water mark if needed.
+ */
+static inline void statsCountAllocs(pool_region_stats_t* stats, uint64_t count) {
+  STAT_ADD(&stats->allocs, count);
+  uint64_t live = STAT_ADD(&stats->live, count);
+#ifdef POOL_THREAD_SAFE
+  // Frees folded in from other threads' caches can run ahead of their allocations; skip such transiently negative counts
+  uint64_t high_water = STAT_LOAD(&stats->high_water);
+  while(((int64_t)live > (int64_t)high_water)
+        && !__atomic_compare_exchange_n(&stats->high_water, &high_water, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+#else
+  if(live > stats->high_water) {
+    stats->high_water = live;
+  }
+#endif
+}
+
+static inline void statsCountFrees(pool_region_stats_t* stats, uint64_t count) {
+  STAT_ADD(&stats->frees, count);
+  STAT_ADD(&stats->live, -count);
+}
+
+/*
+ * Copies the counters of one region without tearing any of them.
+ */
+static void readRegionStats(const pool_region_stats_t* stats, pool_region_stats_t* out) {
+  out->block_size = stats->block_size;
+  out->capacity = stats->capacity;
+  out->alignment = stats->alignment;
+  out->padding = stats->padding;
+  out->allocs = STAT_LOAD(&stats->allocs);
+  out->frees = STAT_LOAD(&stats->frees);
+  out->spills = STAT_LOAD(&stats->spills);
+  out->failures = STAT_LOAD(&stats->failures);
+  out->high_water = STAT_LOAD(&stats->high_water);
+  // Frees folded in ahead of the matching allocations from other threads' caches can leave it briefly below zero
+  int64_t live = (int64_t)STAT_LOAD(&stats->live);
+  out->live = (live > 0) ? (uint64_t)live : 0;
+}
+
+#ifdef POOL_TRACE
+#if defined(__x86_64__) || defined(__i386__)
+#define TRACE_CLOCK POOL_TRACE_CLOCK_TSC
+#else
+#define TRACE_CLOCK POOL_TRACE_CLOCK_NS
+#endif
+
+static inline uint64_t traceClock(void) {
+#if TRACE_CLOCK == POOL_TRACE_CLOCK_TSC
+  return __builtin_ia32_rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+/*
+ * Appends an event to the calling thread's ring. The ring has a single writer, so the event is filled in
+ * place and published by a release store of head; readers drop whatever the writer may have overwritten meanwhile.
+ */
+static void traceRecord(pool_t* pool, uint8_t op, uint8_t region, uint8_t* ptr, size_t n, size_t slot) {
+  trace_ring_t* ring = t_trace_ring;
+  if(ring == NULL) {
+    uint32_t idx = __atomic_fetch_add(&g_trace_num_rings, 1, __ATOMIC_RELAXED);
+    if(idx >= POOL_TRACE_THREADS) {
+      __atomic_store_n(&g_trace_num_rings, POOL_TRACE_THREADS, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&g_trace_unringed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    ring = t_trace_ring = &g_trace_rings[idx];
+  }
+  uint64_t head = ring->head;
+  pool_trace_event_t* event = &ring->events[head % POOL_TRACE_EVENTS];
+  *event = (pool_trace_event_t){
+    .timestamp = traceClock(),
+    .pool = (uintptr_t)pool,
+    .ptr = (uintptr_t)ptr,
+    .size = (uint32_t)n,
+    .slot = (uint32_t)slot,
+    .thread = (uint16_t)(ring - g_trace_rings),
+    .op = op,
+    .region = region,
+  };
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#define TRACE_EVENT(pool, op, region, ptr, n, slot) traceRecord((pool), (op), (region), (uint8_t*)(ptr), (n), (slot))
+#else
+#define TRACE_EVENT(pool, op, region, ptr, n, slot) ((void)0)
+#endif
+
+#ifdef POOL_HISTOGRAM
+static size_t histogramIndex(size_t n);
+static size_t histogramBucketSize(size_t idx);
+
+static inline void histogramRecord(size_t n, size_t count) {
+  if(n > 0) {
+#ifdef POOL_THREAD_SAFE
+    __atomic_fetch_add(&g_size_histogram[histogramIndex(n)], count, __ATOMIC_RELAXED);
+#else
+    g_size_histogram[histogramIndex(n)] += count;
+#endif
+  }
+}
+#endif
 
 bool pool_init(size_t* block_sizes, size_t block_size_count) {
-  // Validate block_sizes list and its items
   assert(!f_pool_init); // Trap if the region has already been initialized
-  if((block_sizes == NULL) || (block_size_count == 0) || (block_size_count > UCHAR_MAX + 1)) {
-    // Invalid input parameters
+  g_default_pool = pool_create(g_heap_mem, MAX_HEAP_SIZE, block_sizes, block_size_count);
+  f_pool_init = (g_default_pool != NULL);
+  return f_pool_init;
+}
+
+bool pool_init_sized(size_t* block_sizes, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities) {
+  assert(!f_pool_init); // Trap if the region has already been initialized
+  g_default_pool = pool_create_sized(g_heap_mem, MAX_HEAP_SIZE, block_sizes, class_targets, block_size_count, sizing, capacities);
+  f_pool_init = (g_default_pool != NULL);
+  return f_pool_init;
+}
+
+pool_t* pool_create(void* mem, size_t len, size_t* block_sizes, size_t block_size_count) {
+  return createPool(mem, len, block_sizes, NULL, NULL, block_size_count, POOL_SIZE_BY_WEIGHT, POOL_LAYOUT_INLINE, NULL);
+}
+
+pool_t* pool_create_sized(void* mem, size_t len, size_t* block_sizes, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities) {
+  if(class_targets == NULL) {
+    return NULL;
+  }
+  return createPool(mem, len, block_sizes, NULL, class_targets, block_size_count, sizing, POOL_LAYOUT_INLINE, capacities);
+}
+
+bool pool_init_aligned(size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities) {
+  assert(!f_pool_init); // Trap if the region has already been initialized
+  g_default_pool = pool_create_aligned(g_heap_mem, MAX_HEAP_SIZE, block_sizes, alignments, class_targets, block_size_count, sizing, capacities);
+  f_pool_init = (g_default_pool != NULL);
+  return f_pool_init;
+}
+
+pool_t* pool_create_aligned(void* mem, size_t len, size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, size_t* capacities) {
+  if(alignments == NULL) {
+    return NULL;
+  }
+  return createPool(mem, len, block_sizes, alignments, class_targets, block_size_count, sizing, POOL_LAYOUT_INLINE, capacities);
+}
+
+bool pool_init_layout(size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities) {
+  assert(!f_pool_init); // Trap if the region has already been initialized
+  g_default_pool = pool_create_layout(g_heap_mem, MAX_HEAP_SIZE, block_sizes, alignments, class_targets, block_size_count, sizing, layout, capacities);
+  f_pool_init = (g_default_pool != NULL);
+  return f_pool_init;
+}
+
+pool_t* pool_create_layout(void* mem, size_t len, size_t* block_sizes, size_t* alignments, size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities) {
+  return createPool(mem, len, block_sizes, alignments, class_targets, block_size_count, sizing, layout, capacities);
+}
+
+void* pool_map(size_t* len, unsigned flags, int numa_node, unsigned* granted) {
+  unsigned took_effect = 0;
+  if(granted != NULL) {
+    *granted = 0;
+  }
+  if((len == NULL) || (*len == 0)) {
+    return NULL;
+  }
+#ifdef HAVE_SYS_MMAN_H
+  bool huge = (flags & (POOL_MAP_HUGE_PAGES | POOL_MAP_TRANSPARENT_HUGE_PAGES)) != 0;
+  size_t page_size = huge ? HUGE_PAGE_SIZE : (size_t)sysconf(_SC_PAGESIZE);
+  if(*len > SIZE_MAX - 2 * page_size) {
+    return NULL;
+  }
+  size_t map_len = (*len + page_size - 1) & ~(page_size - 1);
+  uint8_t* mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if(flags & POOL_MAP_HUGE_PAGES) {
+    mem = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(mem != MAP_FAILED) {
+      took_effect |= POOL_MAP_HUGE_PAGES;
+    }
+  }
+#endif
+  if(mem == MAP_FAILED) {
+    // Regular pages; map a page more and trim it so that a huge page mapping starts on a huge page boundary
+    size_t slack = huge ? page_size : 0;
+    uint8_t* raw = mmap(NULL, map_len + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED) {
+#ifdef DEBUG
+      printf("[TMA] Cannot map %zu bytes for a pool!\n", map_len);
+#endif
+      return NULL;
+    }
+    mem = (uint8_t*)(((uintptr_t)raw + slack) & ~(uintptr_t)(page_size - 1));
+    if(huge && (mem > raw)) {
+      munmap(raw, mem - raw);
+    }
+    if(raw + map_len + slack > mem + map_len) {
+      munmap(mem + map_len, raw + map_len + slack - (mem + map_len));
+    }
+#ifdef MADV_HUGEPAGE
+    if(huge && (madvise(mem, map_len, MADV_HUGEPAGE) == 0)) {
+      took_effect |= POOL_MAP_TRANSPARENT_HUGE_PAGES;
+    }
+#endif
+  }
+
+#ifdef SYS_mbind
+  // Bind before the first touch, which is when pages get placed
+  if((numa_node >= 0) && (numa_node < MAP_MAX_NUMA_NODES)) {
+    unsigned long node_mask[MAP_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = {0};
+    node_mask[numa_node / (8 * sizeof(unsigned long))] = 1UL << (numa_node % (8 * sizeof(unsigned long)));
+    if(syscall(SYS_mbind, mem, map_len, MPOL_BIND, node_mask, MAP_MAX_NUMA_NODES + 1, 0) == 0) {
+      took_effect |= POOL_MAP_NUMA_BOUND;
+    }
+  }
+#endif
+
+  if(flags & POOL_MAP_POPULATE) {
+    for(size_t offset = 0; offset < map_len; offset += (size_t)sysconf(_SC_PAGESIZE)) {
+      ((volatile uint8_t*)mem)[offset] = 0;
+    }
+    took_effect |= POOL_MAP_POPULATE;
+  }
+
+  *len = map_len;
+  if(granted != NULL) {
+    *granted = took_effect;
+  }
+  return mem;
+#else
+  (void)flags;
+  (void)numa_node;
+  return NULL;
+#endif
+}
+
+void pool_unmap(void* mem, size_t len) {
+#ifdef HAVE_SYS_MMAN_H
+  if(mem != NULL) {
+    munmap(mem, len);
+  }
+#else
+  (void)mem;
+  (void)len;
+#endif
+}
+
+bool pool_map_default_heap(unsigned flags, int numa_node) {
+  assert(!f_pool_init); // Trap if the heap is already in use
+  size_t len = MAX_HEAP_SIZE;
+  uint8_t* mem = pool_map(&len, flags, numa_node, NULL);
+  if(mem == NULL) {
     return false;
   }
+  if(g_heap_mem != g_pool_heap) {
+    pool_unmap(g_heap_mem, g_heap_len);
+  }
+  g_heap_mem = mem;
+  g_heap_len = len;
+  return true;
+}
+
+pool_t* pool_create_file(const char* path, size_t len, size_t* block_sizes, size_t block_size_count) {
+#ifdef HAVE_SYS_MMAN_H
+  if((path == NULL) || (len == 0) || (len > MAX_POOL_SIZE)) {
+    return NULL;
+  }
+  // Never overwrite an existing file; it may hold another pool
+  int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if(fd < 0) {
+#ifdef DEBUG
+    printf("[TMA] Cannot create pool file %s!\n", path);
+#endif
+    return NULL;
+  }
+  size_t file_len = POOL_FILE_HEADER_LEN + len;
+  uint8_t* mem = MAP_FAILED;
+  if(ftruncate(fd, (off_t)file_len) == 0) {
+    mem = mmap(NULL, file_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  pool_t* pool = (mem != MAP_FAILED) ? pool_create(mem + POOL_FILE_HEADER_LEN, len, block_sizes, block_size_count) : NULL;
+  if(pool == NULL) {
+    if(mem != MAP_FAILED) {
+      munmap(mem, file_len);
+    }
+    unlink(path);
+    return NULL;
+  }
+  assert((uint8_t*)pool == mem + POOL_FILE_HEADER_LEN);
+  pool_file_header_t* header = (pool_file_header_t*)mem;
+  *header = (pool_file_header_t){
+    .magic = POOL_FILE_MAGIC,
+    .version = POOL_FILE_VERSION,
+    .num_block_size = pool->num_block_size,
+    .file_len = file_len,
+    .base = (uintptr_t)mem,
+    .pool_len = sizeof(pool_t),
+    .index_len = sizeof(pool_index_t),
+    .stats_len = sizeof(pool_region_stats_t),
+    .region_lookup_shift = REGION_LOOKUP_SHIFT,
+  };
+  return pool;
+#else
+  (void)path;
+  (void)len;
+  (void)block_sizes;
+  (void)block_size_count;
+  return NULL;
+#endif
+}
+
+pool_t* pool_attach(const char* path, size_t* block_sizes, size_t block_size_count) {
+#ifdef HAVE_SYS_MMAN_H
+  int fd = (path != NULL) ? open(path, O_RDWR) : -1;
+  if(fd < 0) {
+    return NULL;
+  }
+  pool_file_header_t header;
+  struct stat st;
+  if((fstat(fd, &st) != 0) || (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) || (header.magic != POOL_FILE_MAGIC)
+     || (header.version != POOL_FILE_VERSION) || (header.file_len != (uint64_t)st.st_size) || (header.file_len <= POOL_FILE_HEADER_LEN)
+     || (header.file_len - POOL_FILE_HEADER_LEN > MAX_POOL_SIZE)) {
+#ifdef DEBUG
+    printf("[TMA] %s is not a pool file of this version!\n", path);
+#endif
+    close(fd);
+    return NULL;
+  }
+
+  // Ask for the address the pool was last used at, so that pointers kept in its blocks stay valid
+  int fixed = 0;
+#ifdef MAP_FIXED_NOREPLACE
+  fixed = MAP_FIXED_NOREPLACE;
+#endif
+  uint8_t* mem = mmap((void*)(uintptr_t)header.base, header.file_len, PROT_READ | PROT_WRITE, MAP_SHARED | fixed, fd, 0);
+  if(mem == MAP_FAILED) {
+    mem = mmap(NULL, header.file_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if(mem == MAP_FAILED) {
+    return NULL;
+  }
+  pool_t* pool = (pool_t*)(mem + POOL_FILE_HEADER_LEN);
+  bool valid = validPoolFile(&header, pool);
+
+  // A block size list that differs from the stored one would give every block a different size; refuse it
+  if(valid && (block_sizes != NULL)) {
+    valid = (block_size_count == pool->num_block_size);
+    bool matched[UCHAR_MAX] = {false};
+    for(size_t i = 0; valid && (i < pool->num_block_size); i++) {
+      size_t j = 0;
+      while((j < block_size_count) && (matched[j] || (block_sizes[j] != pool->region_stats[i].block_size))) {
+        j++;
+      }
+      valid = (j < block_size_count);
+      if(valid) {
+        matched[j] = true;
+      }
+    }
+  }
+  if(!valid) {
+#ifdef DEBUG
+    printf("[TMA] Pool file %s does not match this build or block size list!\n", path);
+#endif
+    munmap(mem, header.file_len);
+    return NULL;
+  }
+
+  if((uintptr_t)mem != header.base) {
+    rebasePool(pool, (uint8_t*)(uintptr_t)header.base, mem);
+    ((pool_file_header_t*)mem)->base = (uintptr_t)mem;
+  }
+#ifdef POOL_MAGAZINES
+  // Caches left over from an earlier attach at this address belong to that mapping
+  pool->id = __atomic_add_fetch(&g_pool_ids, 1, __ATOMIC_RELAXED);
+#endif
+  return pool;
+#else
+  (void)path;
+  (void)block_sizes;
+  (void)block_size_count;
+  return NULL;
+#endif
+}
+
+void pool_detach(pool_t* pool) {
+#ifdef HAVE_SYS_MMAN_H
+  if(pool == NULL) {
+    return;
+  }
+  pool_file_header_t* header = fileHeader(pool);
+#ifdef POOL_MAGAZINES
+  magazineFlushPool(pool);
+#endif
+  msync(header, header->file_len, MS_SYNC);
+  munmap(header, header->file_len);
+#else
+  (void)pool;
+#endif
+}
+
+void pool_set_root(pool_t* pool, void* root) {
+  pool_file_header_t* header = fileHeader(pool);
+  assert((root == NULL) || (((uint8_t*)root >= pool->heap_start) && ((uint8_t*)root < pool->alloc_end_addr)));  // Trap on roots outside the pool
+  header->root = (root != NULL) ? (uint64_t)((uint8_t*)root - (uint8_t*)header) : 0;
+}
+
+void* pool_root(pool_t* pool) {
+  pool_file_header_t* header = fileHeader(pool);
+  return (header->root != 0) ? (uint8_t*)header + header->root : NULL;
+}
+
+/*
+ * Lays out a pool in mem. Without class_targets every region gets about the same number of blocks;
+ * otherwise the regions are sized from class_targets as sizing says, and their capacities are written
+ * to capacities (when not NULL) in the order of block_sizes. Without alignments every region is packed.
+ * The split layout gathers every occupation and summary map in the metadata block ahead of the regions.
+ */
+static pool_t* createPool(void* mem, size_t len, size_t* block_sizes, const size_t* alignments, const size_t* class_targets, size_t block_size_count, pool_sizing_t sizing, pool_layout_t layout, size_t* capacities) {
+  // Validate block_sizes list and its items
+  if((mem == NULL) || (block_sizes == NULL) || (block_size_count == 0) || (block_size_count > UCHAR_MAX)) {
+    // Invalid input parameters
+    return NULL;
+  }
+
+  // Slots of an aligned block size are spaced a multiple of its alignment apart
+  size_t slot_align[UCHAR_MAX];
+  size_t strides[UCHAR_MAX];
+  for(uint8_t i = 0; i < block_size_count; i++) {
+    if((block_sizes[i] == 0) || (block_sizes[i] >= MAX_POOL_SIZE)){
+      // Invalid list entry
+      return NULL;
+    }
+    slot_align[i] = resolveAlignment(block_sizes[i], (alignments != NULL) ? alignments[i] : POOL_ALIGN_PACKED);
+    if(slot_align[i] == 0) {
+      // Alignment is not a power of two up to POOL_ALIGN_MAX
+      return NULL;
+    }
+    strides[i] = (block_sizes[i] + slot_align[i] - 1) & ~(slot_align[i] - 1);
+    if(strides[i] >= MAX_POOL_SIZE) {
+      return NULL;
+    }
+  }
+
+  if((layout != POOL_LAYOUT_INLINE) && (layout != POOL_LAYOUT_SPLIT)) {
+    return NULL;
+  }
+
+  // Occupation maps are accessed as 64-bit words; start the pool on a word boundary, or on a cache line
+  // boundary for the split layout so that the metadata block shares no line with anything else
+  size_t heap_align = (layout == POOL_LAYOUT_SPLIT) ? POOL_ALIGN_CACHE_LINE : sizeof(uint64_t);
+  uint8_t* heap_start = (uint8_t*)(((uintptr_t)mem + heap_align - 1) & ~(uintptr_t)(heap_align - 1));
+  if((len < (size_t)(heap_start - (uint8_t*)mem) + sizeof(pool_t)) || (len - (heap_start - (uint8_t*)mem) > MAX_POOL_SIZE)) {
+    // Memory area cannot hold the pool instance, or is too large for pool_index_t offsets
+    return NULL;
+  }
+  size_t heap_len = len - (heap_start - (uint8_t*)mem);
+  uint8_t* heap_end = heap_start + heap_len;
+  uint8_t* heap_ptr = heap_start;    // Pointer to current heap usage
+
+  pool_t* pool = (pool_t*)heap_ptr;
+  heap_ptr += ALIGN_WORD(sizeof(pool_t));
+  *pool = (pool_t){0};
+#ifdef POOL_MAGAZINES
+  pool->id = __atomic_add_fetch(&g_pool_ids, 1, __ATOMIC_RELAXED);
+#endif
+  pool->heap_start = heap_start;
+  pool->heap_len = heap_len;
+  pool->num_block_size = block_size_count;
+  size_t num_block_size = block_size_count;
+  size_t region_lookup_entries = (heap_len + (1 << REGION_LOOKUP_SHIFT) - 1) >> REGION_LOOKUP_SHIFT;
+
+  // Fixed-size metadata must leave room for at least one block
+  size_t metadata_len = ALIGN_WORD(sizeof(pool_t)) + ALIGN_WORD(sizeof(uint8_t) * CLASS_LOOKUP_ENTRIES) + ALIGN_WORD(sizeof(uint8_t) * region_lookup_entries)
+                        + 2 * ALIGN_WORD(num_block_size * sizeof(pool_index_t)) + num_block_size * sizeof(pool_region_stats_t)
+                        + ALIGN_WORD(num_block_size * (sizeof(uint64_t*) + sizeof(pool_index_t) + sizeof(pool_index_t))) + num_block_size * sizeof(uint8_t*);
+#ifdef POOL_SPLIT
+  metadata_len += ALIGN_WORD(POOL_SPLIT_SLOTS * sizeof(split_slot_t));
+#endif
+  if(metadata_len >= heap_len) {
+    return NULL;
+  }
+
+  // Size-class lookup table; filled in once the block size list is sorted
+  pool->class_lookup = heap_ptr;
+  heap_ptr += ALIGN_WORD(sizeof(uint8_t) * CLASS_LOOKUP_ENTRIES);
+
+  // Pointer-to-region lookup table; filled in once the regions are laid out
+  pool->region_lookup = heap_ptr;
+  heap_ptr += ALIGN_WORD(sizeof(uint8_t) * region_lookup_entries);
+
+  // Lowest summary word of each region that may have a clear bit
+  pool->block_summary_hint = (pool_index_t*)heap_ptr;
+  heap_ptr += ALIGN_WORD(sizeof(pool_index_t) * num_block_size);
+
+  // Next-fit cursor of each region
+  pool->block_cursor = (pool_index_t*)heap_ptr;
+  heap_ptr += ALIGN_WORD(sizeof(pool_index_t) * num_block_size);
+
+#ifdef POOL_SPLIT
+  // Split table; every entry starts free
+  pool->splits = (split_slot_t*)heap_ptr;
+  memset(pool->splits, 0, POOL_SPLIT_SLOTS * sizeof(split_slot_t));
+  heap_ptr += ALIGN_WORD(POOL_SPLIT_SLOTS * sizeof(split_slot_t));
+#endif
+
+  // Summary map addresses; the summary words themselves follow the last region, or the occupation maps in the split layout
+  pool->block_summary_addr = (uint64_t**)heap_ptr;
+  heap_ptr += sizeof(uint64_t*) * num_block_size;
+
+  // Running counters of each region; block size and capacity are filled in once the regions are laid out
+  pool->region_stats = (pool_region_stats_t*)heap_ptr;
+  heap_ptr += sizeof(pool_region_stats_t) * num_block_size;
+
+  // Copy over block size list; aligned block sizes are stored as their slot stride
+  pool_index_t* block_sizes_list = (pool_index_t*)heap_ptr;
+  pool->block_sizes_list = block_sizes_list;
+  for(uint8_t i = 0; i < num_block_size; i++){
+    *((pool_index_t*)heap_ptr) = (pool_index_t)(strides[i]);
+    heap_ptr += sizeof(pool_index_t);
+  }
+  insertionSort(block_sizes_list, num_block_size);
+  buildClassLookup(pool);
+
+  // Position in block_sizes of each sorted region, so that alignments, targets and capacities follow their block size
+  uint8_t caller_idx[UCHAR_MAX];
+  bool matched[UCHAR_MAX] = {false};
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    uint8_t j = 0;
+    while(matched[j] || (strides[j] != block_sizes_list[i])) {
+      j++;
+    }
+    matched[j] = true;
+    caller_idx[i] = j;
+  }
+
+  pool_index_t* block_offset_list = (pool_index_t*)heap_ptr;
+  pool->block_offset_list = block_offset_list;
+
+  // Initialize temporary counts array in heap (use the offset list region)
+  pool_index_t* temp_block_counts = block_offset_list;
+  for(uint8_t i = 0; i < num_block_size; i++){
+    *((pool_index_t*)heap_ptr) = 0;
+    heap_ptr += sizeof(pool_index_t);
+  }
+
+  // Keep the base address list and every region word-aligned
+  heap_ptr = heap_start + ALIGN_WORD(heap_ptr - heap_start);
+  uint8_t** block_base_addr = (uint8_t **) heap_ptr;
+  pool->block_base_addr = block_base_addr;
+  heap_ptr += sizeof(uint8_t*) * num_block_size;
+  assert(heap_ptr < heap_end);
+
+  // Available = heap - pool - class_lookup - region_lookup - summary_addr_list - block_size_list - offset_list - base_addr_list,
+  // less the worst-case padding that aligns the first slot of each region past the word alignment it starts at.
+  // The split layout starts every region's slots on a cache line boundary at least
+  size_t available_bytes = heap_end - heap_ptr;
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    size_t align = slot_align[i];
+    if((layout == POOL_LAYOUT_SPLIT) && (align < POOL_ALIGN_CACHE_LINE)) {
+      align = POOL_ALIGN_CACHE_LINE;
+    }
+    size_t align_padding = (align > sizeof(uint64_t)) ? align - sizeof(uint64_t) : 0;
+    if(align_padding >= available_bytes) {
+      return NULL;
+    }
+    available_bytes -= align_padding;
+  }
+
+  if(class_targets == NULL) {
+    growRegionsEvenly(block_sizes_list, temp_block_counts, num_block_size, available_bytes);
+  } else {
+    size_t targets[UCHAR_MAX];
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      targets[i] = class_targets[caller_idx[i]];
+    }
+    if(!sizeRegions(block_sizes_list, targets, num_block_size, sizing, available_bytes, temp_block_counts)) {
+#ifdef DEBUG
+      printf("[TMA] Requested region sizes do not fit the pool!\n");
+#endif
+      return NULL;
+    }
+  }
+
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    if(temp_block_counts[i] == 0) {
+      // ERROR: Not all block sizes could be allocated
+      return NULL;
+    }
+  }
+  if(capacities != NULL) {
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      capacities[caller_idx[i]] = temp_block_counts[i];
+    }
+  }
+
+  // Place the occupation map, summary map and slots of each region. The offset list holds the block counts
+  // until the regions are placed, so keep a copy
+  size_t block_counts[UCHAR_MAX];
+  uint8_t* slot_base[UCHAR_MAX];
+  size_t region_gap[UCHAR_MAX];
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    block_counts[i] = temp_block_counts[i];
+  }
+  if(layout == POOL_LAYOUT_SPLIT) {
+    // All occupation maps, then all summary maps, then the regions' slots each on a cache line boundary
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      block_base_addr[i] = heap_ptr;
+      heap_ptr += sizeof(uint64_t) * ((block_counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS);
+    }
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      pool_index_t occmap_num_words = (block_counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+      pool->block_summary_addr[i] = (uint64_t*)heap_ptr;
+      heap_ptr += sizeof(uint64_t) * ((occmap_num_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS);
+    }
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      size_t align = (slot_align[caller_idx[i]] > POOL_ALIGN_CACHE_LINE) ? slot_align[caller_idx[i]] : POOL_ALIGN_CACHE_LINE;
+      slot_base[i] = (uint8_t*)(((uintptr_t)heap_ptr + align - 1) & ~(uintptr_t)(align - 1));
+      region_gap[i] = slot_base[i] - heap_ptr;
+      heap_ptr = slot_base[i] + ALIGN_WORD(block_counts[i] * block_sizes_list[i]);
+    }
+    pool->alloc_end_addr = heap_ptr;
+  } else {
+    // Each region's slots right behind its occupation map; aligned regions start late enough that their first slot is aligned
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      size_t occmap_len = sizeof(uint64_t) * ((block_counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS);
+      size_t align = slot_align[caller_idx[i]];
+      slot_base[i] = (uint8_t*)(((uintptr_t)heap_ptr + occmap_len + align - 1) & ~(uintptr_t)(align - 1));
+      block_base_addr[i] = slot_base[i] - occmap_len;
+      region_gap[i] = block_base_addr[i] - heap_ptr;
+      heap_ptr = slot_base[i] + ALIGN_WORD(block_counts[i] * block_sizes_list[i]);
+    }
+    pool->alloc_end_addr = heap_ptr;
+    // The summary words follow the last region
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      pool_index_t occmap_num_words = (block_counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+      pool->block_summary_addr[i] = (uint64_t*)heap_ptr;
+      heap_ptr += sizeof(uint64_t) * ((occmap_num_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS);
+    }
+  }
+  assert(heap_ptr <= heap_end);
+
+  // Prepare memory regions
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    size_t block_size = block_sizes[caller_idx[i]];
+    pool->region_stats[i] = (pool_region_stats_t){
+      .block_size = block_size,
+      .capacity = block_counts[i],
+      .alignment = (size_t)1 << __builtin_ctzll((uintptr_t)slot_base[i] | block_sizes_list[i]),
+      .padding = block_counts[i] * (block_sizes_list[i] - block_size) + region_gap[i],
+    };
+    // Set slot offset from block_base_addr
+    block_offset_list[i] = slot_base[i] - block_base_addr[i];
+    clearRegionMaps(pool, i);
+  }
+  buildRegionLookup(pool);
+  return pool;
+}
+
+
+void* pool_malloc(size_t n){
+  assert(f_pool_init); // Trap on attempt to malloc before pool initialization
+  return pool_malloc_h(g_default_pool, n);
+}
+
+void* pool_malloc_h(pool_t* pool, size_t n){
+  // Validate input
+  assert(pool != NULL);
+#ifdef POOL_HISTOGRAM
+  histogramRecord(n, 1);
+#endif
+  if((n == 0 ) || (n > pool->block_sizes_list[pool->num_block_size-1])) {
+    // Invalid request size
+    return NULL;
+  }
+
+  if(n > pool->block_sizes_list[pool->num_block_size - 1]) {
+    // Requested size greater than allocable block
+#ifdef DEBUG
+    printf("[TMA] Requested size greater than largest block size!\n");
+#endif
+    return NULL;
+  }
+  return claimBlock(pool, n, 1, pool->num_block_size);
+}
+
+void* pool_aligned_alloc(size_t align, size_t n){
+  assert(f_pool_init); // Trap on attempt to malloc before pool initialization
+  return pool_aligned_alloc_h(g_default_pool, align, n);
+}
+
+void* pool_aligned_alloc_h(pool_t* pool, size_t align, size_t n){
+  assert(pool != NULL);
+#ifdef POOL_HISTOGRAM
+  histogramRecord(n, 1);
+#endif
+  if((n == 0) || (n > pool->block_sizes_list[pool->num_block_size - 1]) || (align == 0) || ((align & (align - 1)) != 0)) {
+#ifdef DEBUG
+    printf("[TMA] Requested size is zero or greater than largest block size, or alignment is not a power of two!\n");
+#endif
+    return NULL;
+  }
+  return claimBlock(pool, n, align, pool->num_block_size);
+}
+
+void* pool_malloc_near(size_t n, const void* hint){
+  assert(f_pool_init); // Trap on attempt to malloc before pool initialization
+  return pool_malloc_near_h(g_default_pool, n, hint);
+}
+
+void* pool_malloc_near_h(pool_t* pool, size_t n, const void* hint){
+  assert(pool != NULL);
+  if((n == 0) || (n > pool->block_sizes_list[pool->num_block_size - 1])) {
+#ifdef POOL_HISTOGRAM
+    histogramRecord(n, 1);
+#endif
+    return NULL;
+  }
+  uint8_t* hint_ptr = (uint8_t*)hint;
+  if((hint_ptr != NULL) && (hint_ptr >= slotBase(pool, 0)) && (hint_ptr < pool->alloc_end_addr)) {
+    uint8_t i = regionIndex(pool, hint_ptr);
+    // Interior pointers name their block; addresses between regions' slots, or past the last slot, have no slot to start from
+    if((i == sizeClassIndex(pool, n)) && (hint_ptr >= slotBase(pool, i))) {
+      pool_index_t target = (hint_ptr - slotBase(pool, i)) / pool->block_sizes_list[i];
+      pool_index_t free_slot_loc;
+      if((target < pool->region_stats[i].capacity) && claimNearSlot(pool, i, target, &free_slot_loc)) {
+#ifdef POOL_HISTOGRAM
+        histogramRecord(n, 1);
+#endif
+        statsCountAllocs(&pool->region_stats[i], 1);
+        uint8_t* ptr = slotBase(pool, i) + free_slot_loc * pool->block_sizes_list[i];
+        TRACE_EVENT(pool, POOL_TRACE_MALLOC, i, ptr, n, free_slot_loc);
+        return ptr;
+      }
+    }
+  }
+  return pool_malloc_h(pool, n);
+}
+
+bool pool_set_placement(pool_placement_t placement){
+  assert(f_pool_init); // Trap on attempt to configure the pool before initialization
+  return pool_set_placement_h(g_default_pool, placement);
+}
+
+bool pool_set_placement_h(pool_t* pool, pool_placement_t placement){
+  assert(pool != NULL);
+  if((placement != POOL_PLACE_FIRST_FIT) && (placement != POOL_PLACE_NEXT_FIT)) {
+    return false;
+  }
+  pool->placement = placement;
+  return true;
+}
+
+/*
+ * Claims a block of at least n bytes whose address is a multiple of min_align, starting at the smallest
+ * block size that fits and spilling into larger ones, up to region end, when a region is full or not aligned enough.
+ * Only a search that reaches the largest block size counts as a failure.
+ */
+static inline void* claimBlock(pool_t* pool, size_t n, size_t min_align, uint8_t end) {
+  // Start at the smallest block that fits the data; spill into larger blocks when it is full
+  uint8_t fit = sizeClassIndex(pool, n);
+#ifdef POOL_MAGAZINES
+  if((fit < POOL_MAGAZINE_CLASSES) && ((min_align == 1) || (pool->region_stats[fit].alignment >= min_align))) {
+    uint8_t* cached = magazinePop(pool, fit);
+    if(cached != NULL) {
+      TRACE_EVENT(pool, POOL_TRACE_MALLOC, fit, cached, n, (cached - slotBase(pool, fit)) / pool->block_sizes_list[fit]);
+      return cached;
+    }
+  }
+#endif
+  for(uint8_t i = fit; i < end; i++) {
+    if((min_align > 1) && (pool->region_stats[i].alignment < min_align)) {
+      continue;
+    }
+    // Try to find a free slot in the smallest block size that will fit the request
+    pool_index_t free_slot_loc = 0;
+    uint8_t* base_addr = pool->block_base_addr[i];
+    if(claimSlots(pool, base_addr, &free_slot_loc, 1, i) == 1) {
+      statsCountAllocs(&pool->region_stats[i], 1);
+      if(i != fit) {
+        STAT_ADD(&pool->region_stats[fit].spills, 1);
+      }
+      TRACE_EVENT(pool, POOL_TRACE_MALLOC, i, slotBase(pool, i) + free_slot_loc * pool->block_sizes_list[i], n, free_slot_loc);
+      // Calculate the location of the free slot
+      return (void*) (base_addr + pool->block_offset_list[i] + free_slot_loc * pool->block_sizes_list[i]);
+    }
+#ifdef POOL_SPLIT
+    if((i == fit) && (min_align == 1) && pool->splitting) {
+      // Before spilling into a whole larger slot, take a sub-slot of one
+      split_slot_t* split;
+      uint8_t* sub_slot = splitClaim(pool, fit, end, &split);
+      if(sub_slot != NULL) {
+        TRACE_EVENT(pool, POOL_TRACE_MALLOC, split->region, sub_slot, n, split->slot);
+        return sub_slot;
+      }
+    }
+#endif
+  }
+   // ERROR: Did not find a block that fit the requested size
+   if(end == pool->num_block_size) {
+     STAT_ADD(&pool->region_stats[fit].failures, 1);
+     TRACE_EVENT(pool, POOL_TRACE_MALLOC, fit, NULL, n, 0);
+   }
+   return NULL;
+}
+
+size_t pool_malloc_bulk(size_t n, void** out, size_t count){
+  assert(f_pool_init); // Trap on attempt to malloc before pool initialization
+  return pool_malloc_bulk_h(g_default_pool, n, out, count);
+}
+
+size_t pool_malloc_bulk_h(pool_t* pool, size_t n, void** out, size_t count){
+  assert(pool != NULL);
+#ifdef POOL_HISTOGRAM
+  histogramRecord(n, count);
+#endif
+  if((n == 0) || (n > pool->block_sizes_list[pool->num_block_size - 1])) {
+#ifdef DEBUG
+    printf("[TMA] Requested size is zero or greater than largest block size!\n");
+#endif
+    return 0;
+  }
+
+  // Claim slots BULK_CHUNK at a time from each region's bitmap, spilling into larger blocks as regions fill up
+  size_t allocated = 0;
+  pool_index_t locs[BULK_CHUNK];
+  uint8_t fit = sizeClassIndex(pool, n);
+  for(uint8_t i = fit; (i < pool->num_block_size) && (allocated < count); i++) {
+    uint8_t* slot_base = slotBase(pool, i);
+    size_t region_allocated = 0;
+    pool_index_t claimed;
+    do {
+      pool_index_t want = (count - allocated < BULK_CHUNK) ? (pool_index_t)(count - allocated) : BULK_CHUNK;
+      claimed = claimSlots(pool, pool->block_base_addr[i], locs, want, i);
+      for(pool_index_t k = 0; k < claimed; k++) {
+        out[allocated++] = slot_base + (size_t)locs[k] * pool->block_sizes_list[i];
+        TRACE_EVENT(pool, POOL_TRACE_MALLOC, i, out[allocated - 1], n, locs[k]);
+      }
+      region_allocated += claimed;
+      if(claimed < want) {
+        break;   // Region is full
+      }
+    } while(allocated < count);
+    if(region_allocated > 0) {
+      statsCountAllocs(&pool->region_stats[i], region_allocated);
+      if(i != fit) {
+        STAT_ADD(&pool->region_stats[fit].spills, region_allocated);
+      }
+    }
+  }
+  if(allocated < count) {
+    STAT_ADD(&pool->region_stats[fit].failures, count - allocated);
+#ifdef POOL_TRACE
+    for(size_t k = allocated; k < count; k++) {
+      TRACE_EVENT(pool, POOL_TRACE_MALLOC, fit, NULL, n, 0);
+    }
+#endif
+  }
+  return allocated;
+}
+
+void pool_free(void* ptr){
+  assert(f_pool_init);  // Trap on attempt to free before pool initialization
+  pool_free_h(g_default_pool, ptr);
+}
+
+void pool_free_h(pool_t* pool, void* ptr){
+  assert(pool != NULL);
+
+  if((ptr == NULL) || ((uint8_t*)ptr < slotBase(pool, 0)) || ((uint8_t*)ptr >= pool->alloc_end_addr)) {
+#ifdef DEBUG
+    printf("[TMA] Invalid pointer %p to free!\n", ptr);
+#endif
+    return;  // Invalid pointer
+  }
+
+  // Find which block the pointer belongs to
+  releaseSlot(pool, regionIndex(pool, (uint8_t*)ptr), (uint8_t*)ptr);
+}
+
+void pool_free_bulk(void** ptrs, size_t count){
+  assert(f_pool_init);  // Trap on attempt to free before pool initialization
+  pool_free_bulk_h(g_default_pool, ptrs, count);
+}
+
+void pool_free_bulk_h(pool_t* pool, void** ptrs, size_t count){
+  assert(pool != NULL);
+
+  // Gather runs of pointers that share an occupation map word and clear each run with one update
+  uint8_t run_region = 0;
+  pool_index_t run_word = 0;
+  uint64_t run_mask = 0;
+  for(size_t k = 0; k < count; k++) {
+    uint8_t* ptr = ptrs[k];
+    if((ptr == NULL) || (ptr < slotBase(pool, 0)) || (ptr >= pool->alloc_end_addr)) {
+#ifdef DEBUG
+      printf("[TMA] Invalid pointer %p to free!\n", (void*)ptr);
+#endif
+      continue;  // Invalid pointer
+    }
+    uint8_t i = regionIndex(pool, ptr);
+    uint8_t* slot_base = slotBase(pool, i);
+    pool_index_t slot = (ptr - slot_base) / pool->block_sizes_list[i];
+    if(slot >= pool->region_stats[i].capacity) {
+#ifdef DEBUG
+      printf("[TMA] Invalid pointer %p to free!\n", (void*)ptr);
+#endif
+      continue;  // Pointer lies past the last slot, in the next region's occupation map or padding
+    }
+#ifdef POOL_SPLIT
+    if((pool->split_stats.split_slots > 0) && splitRelease(pool, ptr)) {
+      continue;
+    }
+#endif
+    // Trap if the pointer is unaligned
+    assert((ptr - slot_base) % pool->block_sizes_list[i] == 0);
+    uint64_t slot_mask = UINT64_C(1) << (slot % OCC_WORD_BITS);
+
+    if((run_mask != 0) && ((i != run_region) || (slot / OCC_WORD_BITS != run_word))) {
+      releaseWordSlots(pool, run_region, run_word, run_mask);
+      statsCountFrees(&pool->region_stats[run_region], __builtin_popcountll(run_mask));
+      run_mask = 0;
+    }
+    // Trap on the same pointer twice in one call
+    assert(!(run_mask & slot_mask));
+    TRACE_EVENT(pool, POOL_TRACE_FREE, i, ptr, 0, slot);
+    run_region = i;
+    run_word = slot / OCC_WORD_BITS;
+    run_mask |= slot_mask;
+  }
+  if(run_mask != 0) {
+    releaseWordSlots(pool, run_region, run_word, run_mask);
+    statsCountFrees(&pool->region_stats[run_region], __builtin_popcountll(run_mask));
+  }
+}
+
+void pool_free_sized(void* ptr, size_t n){
+  assert(f_pool_init);  // Trap on attempt to free before pool initialization
+  pool_free_sized_h(g_default_pool, ptr, n);
+}
+
+void pool_free_sized_h(pool_t* pool, void* ptr, size_t n){
+  assert(pool != NULL);
+
+  if((n > 0) && (n <= pool->block_sizes_list[pool->num_block_size - 1])) {
+    // The pointer is in the block that n maps to unless its allocation spilled into a larger block
+    uint8_t i = sizeClassIndex(pool, n);
+    uint8_t* region_end = ((size_t)i + 1 < pool->num_block_size) ? slotBase(pool, i + 1) : pool->alloc_end_addr;
+    if(((uint8_t*)ptr >= slotBase(pool, i)) && ((uint8_t*)ptr < region_end)) {
+      releaseSlot(pool, i, (uint8_t*)ptr);
+      return;
+    }
+  }
+  pool_free_h(pool, ptr);
+}
+
+void* pool_realloc(void* ptr, size_t n){
+  assert(f_pool_init);  // Trap on attempt to realloc before pool initialization
+  return pool_realloc_h(g_default_pool, ptr, n);
+}
+
+void* pool_realloc_h(pool_t* pool, void* ptr, size_t n){
+  assert(pool != NULL);
+
+  if(ptr == NULL) {
+    return pool_malloc_h(pool, n);
+  }
+  if(n == 0) {
+    pool_free_h(pool, ptr);
+    return NULL;
+  }
+  uint8_t i = slotRegion(pool, (uint8_t*)ptr);
+  uint8_t region = i;
+#ifdef POOL_SPLIT
+  // A sub-slot acts as a block of its sub-slot size, though it lies in the region of the slot that was split
+  size_t sub;
+  split_slot_t* split = splitFind(pool, (uint8_t*)ptr, &sub);
+  if(split != NULL) {
+    region = split->region;
+    i = (sub != SIZE_MAX) ? split->sub_region : pool->num_block_size;
+  }
+#endif
+  if((i == pool->num_block_size) || (n > pool->block_sizes_list[pool->num_block_size - 1])) {
+#ifdef DEBUG
+    printf("[TMA] Invalid pointer %p or size %zu to realloc!\n", ptr, n);
+#endif
+    return NULL;  // Invalid pointer or request size; ptr is left as it was
+  }
+#ifdef POOL_HISTOGRAM
+  histogramRecord(n, 1);
+#endif
+  size_t block_size = pool->block_sizes_list[i];
+  uint8_t fit = sizeClassIndex(pool, n);
+  if(fit == i) {
+    return ptr;  // Still the smallest block size that fits: nothing to move
+  }
+
+  // Growing moves to any larger block size that has room; shrinking only to a block size below the current one
+  void* moved = claimBlock(pool, n, 1, (fit > i) ? pool->num_block_size : i);
+  if(moved == NULL) {
+    // Growing fails and leaves ptr as it was; shrinking keeps the block it has
+    return (fit > i) ? NULL : ptr;
+  }
+  // The old block holds at most block_size live bytes, and a smaller block takes only the first n
+  memcpy(moved, ptr, (n < block_size) ? n : block_size);
+  releaseSlot(pool, region, (uint8_t*)ptr);
+  return moved;
+}
+
+size_t pool_usable_size(void* ptr){
+  assert(f_pool_init);
+  return pool_usable_size_h(g_default_pool, ptr);
+}
+
+size_t pool_usable_size_h(pool_t* pool, void* ptr){
+  assert(pool != NULL);
+#ifdef POOL_SPLIT
+  size_t sub;
+  split_slot_t* split = splitFind(pool, (uint8_t*)ptr, &sub);
+  if(split != NULL) {
+    return (sub != SIZE_MAX) ? pool->block_sizes_list[split->sub_region] : 0;
+  }
+#endif
+  uint8_t i = slotRegion(pool, (uint8_t*)ptr);
+  return (i < pool->num_block_size) ? pool->block_sizes_list[i] : 0;
+}
+
+void pool_reset(void){
+  assert(f_pool_init);  // Trap on attempt to reset before pool initialization
+  pool_reset_h(g_default_pool);
+}
+
+void pool_reset_h(pool_t* pool){
+  assert(pool != NULL);
+#ifdef POOL_MAGAZINES
+  magazineFlushPool(pool);
+#endif
+  for(uint8_t i = 0; i < pool->num_block_size; i++) {
+    resetRegion(pool, i);
+  }
+}
+
+bool pool_reset_region(size_t region){
+  assert(f_pool_init);  // Trap on attempt to reset before pool initialization
+  return pool_reset_region_h(g_default_pool, region);
+}
+
+bool pool_reset_region_h(pool_t* pool, size_t region){
+  assert(pool != NULL);
+  if(region >= pool->num_block_size) {
+#ifdef DEBUG
+    printf("[TMA] Invalid region %zu to reset!\n", region);
+#endif
+    return false;
+  }
+#ifdef POOL_MAGAZINES
+  magazineFlushPool(pool);
+#endif
+  resetRegion(pool, (uint8_t)region);
+  return true;
+}
+
+size_t pool_mark_size(void){
+  assert(f_pool_init);
+  return pool_mark_size_h(g_default_pool);
+}
+
+size_t pool_mark_size_h(pool_t* pool){
+  assert(pool != NULL);
+  size_t words = 0;
+  for(uint8_t i = 0; i < pool->num_block_size; i++) {
+    words += mapWords(pool, i) + (mapWords(pool, i) + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+  }
+#ifdef POOL_SPLIT
+  // The split table follows the maps
+  return words * sizeof(uint64_t) + POOL_SPLIT_SLOTS * sizeof(split_slot_t);
+#else
+  return words * sizeof(uint64_t);
+#endif
+}
+
+void pool_mark(void* mark){
+  assert(f_pool_init);  // Trap on attempt to mark before pool initialization
+  pool_mark_h(g_default_pool, mark);
+}
+
+void pool_mark_h(pool_t* pool, void* mark){
+  assert((pool != NULL) && (mark != NULL));
+#ifdef POOL_MAGAZINES
+  // Cached slots look occupied in the maps; return them first so that the mark records them as free
+  magazineFlushPool(pool);
+#endif
+  // Each region's occupation map followed by its summary map
+  uint8_t* out = mark;
+  for(uint8_t i = 0; i < pool->num_block_size; i++) {
+    pool_index_t om_words = mapWords(pool, i);
+    pool_index_t sm_words = (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+    memcpy(out, pool->block_base_addr[i], om_words * sizeof(uint64_t));
+    out += om_words * sizeof(uint64_t);
+    memcpy(out, pool->block_summary_addr[i], sm_words * sizeof(uint64_t));
+    out += sm_words * sizeof(uint64_t);
+  }
+#ifdef POOL_SPLIT
+  memcpy(out, pool->splits, POOL_SPLIT_SLOTS * sizeof(split_slot_t));
+#endif
+}
+
+void pool_release(const void* mark){
+  assert(f_pool_init);  // Trap on attempt to release before pool initialization
+  pool_release_h(g_default_pool, mark);
+}
+
+void pool_release_h(pool_t* pool, const void* mark){
+  assert((pool != NULL) && (mark != NULL));
+#ifdef POOL_MAGAZINES
+  magazineFlushPool(pool);
+#endif
+  const uint8_t* in = mark;
+  for(uint8_t i = 0; i < pool->num_block_size; i++) {
+    pool_index_t om_words = mapWords(pool, i);
+    pool_index_t sm_words = (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+    uint64_t* occ_map = (uint64_t*)pool->block_base_addr[i];
+    // Blocks allocated since the mark are freed; blocks freed since then come back, so the counters follow both ways
+    uint64_t freed = 0;
+    uint64_t revived = 0;
+    for(pool_index_t j = 0; j < om_words; j++) {
+      uint64_t saved;
+      memcpy(&saved, in + j * sizeof(uint64_t), sizeof(saved));
+      freed += __builtin_popcountll(occ_map[j] & ~saved);
+      revived += __builtin_popcountll(saved & ~occ_map[j]);
+    }
+    memcpy(occ_map, in, om_words * sizeof(uint64_t));
+    in += om_words * sizeof(uint64_t);
+    memcpy(pool->block_summary_addr[i], in, sm_words * sizeof(uint64_t));
+    in += sm_words * sizeof(uint64_t);
+    pool->block_summary_hint[i] = 0;
+    if(freed > 0) {
+      statsCountFrees(&pool->region_stats[i], freed);
+    }
+    if(revived > 0) {
+      statsCountAllocs(&pool->region_stats[i], revived);
+    }
+  }
+#ifdef POOL_SPLIT
+  memcpy(pool->splits, in, POOL_SPLIT_SLOTS * sizeof(split_slot_t));
+  pool->split_stats.split_slots = 0;
+  for(size_t k = 0; k < POOL_SPLIT_SLOTS; k++) {
+    pool->split_stats.split_slots += (pool->splits[k].used != 0);
+  }
+#endif
+}
+
+void pool_destroy(void){
+  assert(f_pool_init);  // Trap on attempt to destroy before pool initialization
+  pool_destroy_h(g_default_pool);
+  g_default_pool = NULL;
+  f_pool_init = false;
+}
+
+void pool_destroy_h(pool_t* pool){
+  assert(pool != NULL);
+#ifdef POOL_MAGAZINES
+  magazineFlushPool(pool);
+  // Sets other threads still hold for this pool no longer match it, or any pool later built in its memory
+  __atomic_store_n(&pool->id, 0, __ATOMIC_RELAXED);
+#else
+  (void)pool;
+#endif
+}
+
+void pool_magazine_flush(void){
+#ifdef POOL_MAGAZINES
+  for(uint8_t k = 0; k < POOL_MAGAZINE_POOLS; k++) {
+    magazineFlushSet(&t_magazine_sets[k]);
+  }
+#endif
+}
+
+void pool_magazine_stats(pool_magazine_stats_t* stats){
+  assert(f_pool_init);
+  pool_magazine_stats_h(g_default_pool, stats);
+}
+
+void pool_magazine_stats_h(pool_t* pool, pool_magazine_stats_t* stats){
+#ifdef POOL_MAGAZINES
+  // Include the calling thread's own pending counts
+  for(uint8_t k = 0; k < POOL_MAGAZINE_POOLS; k++) {
+    if((t_magazine_sets[k].pool == pool) && (t_magazine_sets[k].pool_id == pool->id)) {
+      magazineFoldStats(&t_magazine_sets[k]);
+    }
+  }
+#endif
+  stats->alloc_hits = __atomic_load_n(&pool->magazine_stats.alloc_hits, __ATOMIC_RELAXED);
+  stats->alloc_refills = __atomic_load_n(&pool->magazine_stats.alloc_refills, __ATOMIC_RELAXED);
+  stats->free_hits = __atomic_load_n(&pool->magazine_stats.free_hits, __ATOMIC_RELAXED);
+  stats->free_flushes = __atomic_load_n(&pool->magazine_stats.free_flushes, __ATOMIC_RELAXED);
+}
+
+bool pool_set_splitting(bool enable){
+  assert(f_pool_init); // Trap on attempt to configure the pool before initialization
+  return pool_set_splitting_h(g_default_pool, enable);
+}
+
+bool pool_set_splitting_h(pool_t* pool, bool enable){
+  assert(pool != NULL);
+#ifdef POOL_SPLIT
+  pool->splitting = enable;
+  return true;
+#else
+  (void)enable;
+  return false;
+#endif
+}
+
+void pool_split_stats(pool_split_stats_t* stats){
+  assert(f_pool_init);
+  pool_split_stats_h(g_default_pool, stats);
+}
+
+void pool_split_stats_h(pool_t* pool, pool_split_stats_t* stats){
+  assert((pool != NULL) && (stats != NULL));
+#ifdef POOL_SPLIT
+  *stats = pool->split_stats;
+  stats->sub_slots = 0;
+  stats->sub_live = 0;
+  stats->idle_bytes = 0;
+  for(size_t k = 0; k < POOL_SPLIT_SLOTS; k++) {
+    const split_slot_t* split = &pool->splits[k];
+    if(split->used != 0) {
+      uint64_t live = __builtin_popcountll(split->used);
+      stats->sub_slots += split->sub_count;
+      stats->sub_live += live;
+      stats->idle_bytes += pool->block_sizes_list[split->region] - live * pool->block_sizes_list[split->sub_region];
+    }
+  }
+#else
+  *stats = (pool_split_stats_t){0};
+#endif
+}
+
+size_t pool_stats(pool_region_stats_t* regions, size_t max_regions){
+  assert(f_pool_init);
+  return pool_stats_h(g_default_pool, regions, max_regions);
+}
+
+size_t pool_stats_h(pool_t* pool, pool_region_stats_t* regions, size_t max_regions){
+  assert(pool != NULL);
+#ifdef POOL_MAGAZINES
+  // Include the calling thread's own pending counts
+  for(uint8_t k = 0; k < POOL_MAGAZINE_POOLS; k++) {
+    if((t_magazine_sets[k].pool == pool) && (t_magazine_sets[k].pool_id == pool->id)) {
+      magazineFoldStats(&t_magazine_sets[k]);
+    }
+  }
+#endif
+  for(size_t i = 0; (i < pool->num_block_size) && (i < max_regions); i++) {
+    readRegionStats(&pool->region_stats[i], &regions[i]);
+  }
+  return pool->num_block_size;
+}
+
+size_t pool_histogram(pool_histogram_entry_t* entries, size_t max_entries){
+  size_t num_entries = 0;
+#ifdef POOL_HISTOGRAM
+  for(size_t idx = 1; idx < HIST_BUCKETS; idx++) {
+    uint64_t count = __atomic_load_n(&g_size_histogram[idx], __ATOMIC_RELAXED);
+    if(count == 0) {
+      continue;
+    }
+    if(num_entries < max_entries) {
+      entries[num_entries].size = histogramBucketSize(idx);
+      entries[num_entries].count = count;
+    }
+    num_entries++;
+  }
+#else
+  (void)entries;
+  (void)max_entries;
+#endif
+  return num_entries;
+}
+
+void pool_histogram_reset(void){
+#ifdef POOL_HISTOGRAM
+  for(size_t idx = 0; idx < HIST_BUCKETS; idx++) {
+    __atomic_store_n(&g_size_histogram[idx], 0, __ATOMIC_RELAXED);
+  }
+#endif
+}
+
+bool pool_histogram_save(const char* path){
+#ifdef POOL_HISTOGRAM
+  FILE* out = fopen(path, "w");
+  if(out == NULL) {
+    return false;
+  }
+  for(size_t idx = 1; idx < HIST_BUCKETS; idx++) {
+    uint64_t count = __atomic_load_n(&g_size_histogram[idx], __ATOMIC_RELAXED);
+    if(count > 0) {
+      fprintf(out, "%zu %llu\n", histogramBucketSize(idx), (unsigned long long)count);
+    }
+  }
+  return fclose(out) == 0;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+#ifdef POOL_TRACE
+static int traceEventOrder(const void* a, const void* b) {
+  const pool_trace_event_t* x = a;
+  const pool_trace_event_t* y = b;
+  if(x->timestamp != y->timestamp) {
+    return (x->timestamp < y->timestamp) ? -1 : 1;
+  }
+  return (x->thread > y->thread) - (x->thread < y->thread);
+}
+
+/*
+ * Copies the readable events of every ring to events, up to max_events, and returns how many every ring holds.
+ * Adds the events lost to ring wrap-around and to threads beyond POOL_TRACE_THREADS to dropped when not NULL.
+ */
+static size_t traceGather(pool_trace_event_t* events, size_t max_events, uint64_t* dropped) {
+  size_t held = 0;
+  size_t copied = 0;
+  uint32_t num_rings = __atomic_load_n(&g_trace_num_rings, __ATOMIC_RELAXED);
+  num_rings = (num_rings < POOL_TRACE_THREADS) ? num_rings : POOL_TRACE_THREADS;
+  if(dropped != NULL) {
+    *dropped = __atomic_load_n(&g_trace_unringed, __ATOMIC_RELAXED);
+  }
+  for(uint32_t r = 0; r < num_rings; r++) {
+    trace_ring_t* ring = &g_trace_rings[r];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = __atomic_load_n(&ring->start, __ATOMIC_RELAXED);
+    if(head - first > POOL_TRACE_EVENTS) {
+      if(dropped != NULL) {
+        *dropped += head - first - POOL_TRACE_EVENTS;
+      }
+      first = head - POOL_TRACE_EVENTS;
+    }
+    size_t ring_copied = copied;
+    for(uint64_t e = first; (e < head) && (copied < max_events); e++) {
+      events[copied++] = ring->events[e % POOL_TRACE_EVENTS];
+    }
+    // Events the owning thread overwrote while they were copied are dropped: the slot of event e is rewritten
+    // once head reaches e + POOL_TRACE_EVENTS
+    uint64_t head_after = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    size_t torn = 0;
+    if(head_after >= first + POOL_TRACE_EVENTS) {
+      torn = (size_t)(head_after - POOL_TRACE_EVENTS + 1 - first);
+      torn = (torn < head - first) ? torn : (size_t)(head - first);
+      size_t ring_torn = (torn < copied - ring_copied) ? torn : copied - ring_copied;
+      for(size_t k = ring_copied; k + ring_torn < copied; k++) {
+        events[k] = events[k + ring_torn];
+      }
+      copied -= ring_torn;
+      if(dropped != NULL) {
+        *dropped += torn;
+      }
+    }
+    held += head - first - torn;
+  }
+  qsort(events, copied, sizeof(pool_trace_event_t), traceEventOrder);
+  return held;
+}
+#endif
+
+size_t pool_trace_read(pool_trace_event_t* events, size_t max_events){
+#ifdef POOL_TRACE
+  return traceGather(events, max_events, NULL);
+#else
+  (void)events;
+  (void)max_events;
+  return 0;
+#endif
+}
+
+void pool_trace_reset(void){
+#ifdef POOL_TRACE
+  uint32_t num_rings = __atomic_load_n(&g_trace_num_rings, __ATOMIC_RELAXED);
+  num_rings = (num_rings < POOL_TRACE_THREADS) ? num_rings : POOL_TRACE_THREADS;
+  for(uint32_t r = 0; r < num_rings; r++) {
+    __atomic_store_n(&g_trace_rings[r].start, __atomic_load_n(&g_trace_rings[r].head, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&g_trace_unringed, 0, __ATOMIC_RELAXED);
+#endif
+}
+
+bool pool_trace_dump(const char* path){
+#ifdef POOL_TRACE
+  size_t max_events = (size_t)POOL_TRACE_THREADS * POOL_TRACE_EVENTS;
+  pool_trace_event_t* events = malloc(max_events * sizeof(pool_trace_event_t));
+  if(events == NULL) {
+    return false;
+  }
+  pool_trace_header_t header = {
+    .magic = POOL_TRACE_MAGIC,
+    .version = POOL_TRACE_VERSION,
+    .event_len = sizeof(pool_trace_event_t),
+    .clock = TRACE_CLOCK,
+  };
+  size_t held = traceGather(events, max_events, &header.dropped);
+  header.num_events = (held < max_events) ? held : max_events;
+  FILE* out = fopen(path, "wb");
+  bool written = (out != NULL) && (fwrite(&header, sizeof(header), 1, out) == 1)
+                 && (fwrite(events, sizeof(pool_trace_event_t), header.num_events, out) == header.num_events);
+  free(events);
+  if(out != NULL) {
+    written = (fclose(out) == 0) && written;
+  }
+  return written;
+#else
+  (void)path;
+  return false;
+#endif
+}
+
+pool_elastic_t* pool_elastic_create(size_t* block_sizes, size_t block_size_count, size_t slab_len, size_t max_empty_slabs, const pool_slab_provider_t* provider){
+#ifdef POOL_ELASTIC
+  if((block_sizes == NULL) || (block_size_count == 0) || (block_size_count > UCHAR_MAX) || (slab_len < MIN_SLAB_LEN)
+     || (slab_len > MAX_POOL_SIZE) || ((slab_len & (slab_len - 1)) != 0)) {
+    return NULL;
+  }
+  if(sizeof(pool_elastic_t) + block_size_count * sizeof(elastic_class_t) > slab_len) {
+    return NULL;
+  }
+  pool_index_t sorted_sizes[UCHAR_MAX];
+  for(size_t i = 0; i < block_size_count; i++) {
+    if((block_sizes[i] == 0) || (block_sizes[i] >= slab_len)) {
+      return NULL;
+    }
+    sorted_sizes[i] = (pool_index_t)block_sizes[i];
+  }
+  insertionSort(sorted_sizes, block_size_count);
+
+  pool_slab_provider_t source = (provider != NULL) ? *provider : (pool_slab_provider_t){mapSlab, unmapSlab, NULL};
+  if((source.acquire == NULL) || (source.release == NULL)) {
+    return NULL;
+  }
+  pool_elastic_t* pool = source.acquire(slab_len, source.ctx);
+  if(pool == NULL) {
+    return NULL;
+  }
+  // A block size must fit a slab beside the slab header and the slab pool's metadata, or every request for it would
+  // take a slab from the provider only to give it back; lay out a trial slab pool for each in the bookkeeping slab first
+  for(size_t i = 0; i < block_size_count; i++) {
+    size_t block_size = sorted_sizes[i];
+    pool_t* trial = pool_create((uint8_t*)pool + SLAB_HEADER_LEN, slab_len - SLAB_HEADER_LEN, &block_size, 1);
+    if(trial == NULL) {
+#ifdef DEBUG
+      printf("[TMA] Block size %zu does not fit a %zu B slab!\n", block_size, slab_len);
+#endif
+      source.release(pool, slab_len, source.ctx);
+      return NULL;
+    }
+    pool_destroy_h(trial);
+  }
+  pool->slab_len = slab_len;
+  pool->max_empty_slabs = max_empty_slabs;
+  pool->provider = source;
+  pool->num_classes = block_size_count;
+  for(size_t i = 0; i < block_size_count; i++) {
+    pool->classes[i] = (elastic_class_t){.block_size = sorted_sizes[i]};
+#ifdef POOL_THREAD_SAFE
+    pthread_mutex_init(&pool->classes[i].lock, NULL);
+#endif
+  }
+  return pool;
+#else
+  (void)block_sizes;
+  (void)block_size_count;
+  (void)slab_len;
+  (void)max_empty_slabs;
+  (void)provider;
+  return NULL;
+#endif
+}
+
+void* pool_elastic_malloc(pool_elastic_t* pool, size_t n){
+#ifdef POOL_ELASTIC
+  if((pool == NULL) || (n == 0)) {
+    return NULL;
+  }
+  // Grow the fitting block size before spilling into larger ones
+  for(size_t c = 0; c < pool->num_classes; c++) {
+    if(pool->classes[c].block_size < n) {
+      continue;
+    }
+    void* ptr = elasticClassAlloc(pool, c);
+    if(ptr != NULL) {
+      return ptr;
+    }
+  }
+#ifdef DEBUG
+  printf("[TMA] Elastic pool cannot allocate %zu bytes!\n", n);
+#endif
+#else
+  (void)pool;
+  (void)n;
+#endif
+  return NULL;
+}
+
+void pool_elastic_free(pool_elastic_t* pool, void* ptr){
+#ifdef POOL_ELASTIC
+  if((pool == NULL) || (ptr == NULL)) {
+    return;
+  }
+  pool_slab_t* slab = (pool_slab_t*)((uintptr_t)ptr & ~(uintptr_t)(pool->slab_len - 1));
+  // Trap on pointers from another pool
+  assert(slab->owner == pool);
+  elastic_class_t* cls = &pool->classes[slab->class_idx];
+  ELASTIC_LOCK(cls);
+  pool_free_bulk_h(slab->pool, &ptr, 1);
+  slab->live--;
+  cls->live--;
+  cls->hint = slab;
+  if(slab->live == 0) {
+    cls->empty_slabs++;
+    if(cls->empty_slabs > pool->max_empty_slabs) {
+      elasticSlabRelease(pool, cls, slab);
+    }
+  }
+  ELASTIC_UNLOCK(cls);
+#else
+  (void)pool;
+  (void)ptr;
+#endif
+}
+
+size_t pool_elastic_stats(pool_elastic_t* pool, pool_elastic_stats_t* classes, size_t max_classes){
+#ifdef POOL_ELASTIC
+  for(size_t c = 0; (c < pool->num_classes) && (c < max_classes); c++) {
+    elastic_class_t* cls = &pool->classes[c];
+    ELASTIC_LOCK(cls);
+    classes[c] = (pool_elastic_stats_t){
+      .block_size = cls->block_size,
+      .slabs = cls->num_slabs,
+      .empty_slabs = cls->empty_slabs,
+      .capacity = cls->capacity,
+      .live = cls->live,
+      .slab_acquires = cls->acquires,
+      .slab_releases = cls->releases,
+    };
+    ELASTIC_UNLOCK(cls);
+  }
+  return pool->num_classes;
+#else
+  (void)pool;
+  (void)classes;
+  (void)max_classes;
+  return 0;
+#endif
+}
+
+void pool_elastic_destroy(pool_elastic_t* pool){
+#ifdef POOL_ELASTIC
+  if(pool == NULL) {
+    return;
+  }
+  for(size_t c = 0; c < pool->num_classes; c++) {
+    elastic_class_t* cls = &pool->classes[c];
+    while(cls->slabs != NULL) {
+      elasticSlabRelease(pool, cls, cls->slabs);
+    }
+#ifdef POOL_THREAD_SAFE
+    pthread_mutex_destroy(&cls->lock);
+#endif
+  }
+  pool_slab_provider_t source = pool->provider;
+  source.release(pool, pool->slab_len, source.ctx);
+#else
+  (void)pool;
+#endif
+}
+
+// Helper functions
+/*
+ * Marks every slot of block-size region i free in its occupation and summary maps, except the padding bits past
+ * the last slot and the last occupation map word, which stay set so that they are never handed out.
+ */
+static void clearRegionMaps(pool_t* pool, uint8_t i) {
+  pool_index_t om_words = mapWords(pool, i);
+  pool_index_t sm_words = (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+  uint8_t om_remainder = pool->region_stats[i].capacity % OCC_WORD_BITS;
+  uint8_t sm_remainder = om_words % OCC_WORD_BITS;
+  uint64_t* occ_map = (uint64_t*)pool->block_base_addr[i];
+  uint64_t* summary = pool->block_summary_addr[i];
+
+  memset(occ_map, 0, om_words * sizeof(uint64_t));
+  if(om_remainder > 0) {
+    occ_map[om_words - 1] = ~((UINT64_C(1) << om_remainder) - 1);
+  }
+  // A set summary bit marks an occupation map word with no free slot
+  memset(summary, 0, sm_words * sizeof(uint64_t));
+  if(sm_remainder > 0) {
+    summary[sm_words - 1] = ~((UINT64_C(1) << sm_remainder) - 1);
+  }
+  pool->block_summary_hint[i] = 0;
+  pool->block_cursor[i] = 0;
+}
+
+/*
+ * Frees every block of block-size region i at once, counting them as frees.
+ */
+static void resetRegion(pool_t* pool, uint8_t i) {
+  pool_index_t om_words = mapWords(pool, i);
+  const uint64_t* occ_map = (const uint64_t*)pool->block_base_addr[i];
+  uint64_t occupied = 0;
+  for(pool_index_t j = 0; j < om_words; j++) {
+    occupied += __builtin_popcountll(occ_map[j]);
+  }
+  // The padding bits of the last word are not blocks
+  occupied -= (OCC_WORD_BITS - pool->region_stats[i].capacity % OCC_WORD_BITS) % OCC_WORD_BITS;
+  clearRegionMaps(pool, i);
+  if(occupied > 0) {
+    statsCountFrees(&pool->region_stats[i], occupied);
+  }
+#ifdef POOL_SPLIT
+  // Slots split in this region are freed with their sub-slots
+  for(size_t k = 0; k < POOL_SPLIT_SLOTS; k++) {
+    if((pool->splits[k].used != 0) && (pool->splits[k].region == i)) {
+      pool->splits[k].used = 0;
+      pool->split_stats.split_slots--;
+    }
+  }
+#endif
+}
+
+/*
+ * Returns a slot of block-size region i to the calling thread's cache when it has one,
+ * otherwise straight to the occupation map.
+ */
+static void releaseSlot(pool_t* pool, uint8_t i, uint8_t* ptr) {
+#ifdef POOL_MAGAZINES
+  uint8_t* slot_base = slotBase(pool, i);
+  if((i < POOL_MAGAZINE_CLASSES) && (ptr >= slot_base) && ((size_t)(ptr - slot_base) / pool->block_sizes_list[i] < pool->region_stats[i].capacity)) {
+    // Trap if the pointer is unaligned
+    assert((ptr - slot_base) % pool->block_sizes_list[i] == 0);
+    TRACE_EVENT(pool, POOL_TRACE_FREE, i, ptr, 0, (ptr - slot_base) / pool->block_sizes_list[i]);
+    magazinePush(pool, i, ptr);
+    return;
+  }
+#endif
+#ifdef POOL_SPLIT
+  if((pool->split_stats.split_slots > 0) && splitRelease(pool, ptr)) {
+    return;
+  }
+#endif
+  if(freeSlot(pool, i, ptr)) {
+    statsCountFrees(&pool->region_stats[i], 1);
+    TRACE_EVENT(pool, POOL_TRACE_FREE, i, ptr, 0, (ptr - slotBase(pool, i)) / pool->block_sizes_list[i]);
+  }
+}
+
+/*
+ * Clears the occupation map bit of ptr within block-size region i, and the summary bit of its word.
+ * Returns false if ptr does not point at a slot.
+ */
+static bool freeSlot(pool_t* pool, uint8_t i, uint8_t* ptr) {
+  uint8_t* slot_base = slotBase(pool, i);
+  if((ptr < slot_base) || ((size_t)(ptr - slot_base) / pool->block_sizes_list[i] >= pool->region_stats[i].capacity)) {
+#ifdef DEBUG
+    printf("[TMA] Invalid pointer %p to free!\n", ptr);
+#endif
+    return false;  // Pointer lies outside the slots, in an occupation map or padding
+  }
+
+  // Check occupation map for pointer
+  pool_index_t ptr_alloc_offset = ptr - slot_base;
+
+  // Trap if the pointer is unaligned
+  assert(ptr_alloc_offset % pool->block_sizes_list[i] == 0);
+
+  pool_index_t occ_map_bit_offset = ptr_alloc_offset / (pool->block_sizes_list[i]);
+  releaseWordSlots(pool, i, occ_map_bit_offset / OCC_WORD_BITS, UINT64_C(1) << (occ_map_bit_offset % OCC_WORD_BITS));
+  return true;
+}
+
+/*
+ * Clears the slot_mask bits of occupation map word occ_map_word_offset of block-size region i with one
+ * update, and the word's summary bit if the word was full.
+ */
+static void releaseWordSlots(pool_t* pool, uint8_t i, pool_index_t occ_map_word_offset, uint64_t slot_mask) {
+  uint64_t* occ_map_word = (uint64_t*)pool->block_base_addr[i] + occ_map_word_offset;
+
+  // Set the occupation map bits to 0
+  uint64_t old_word = OCC_FETCH_AND(occ_map_word, ~slot_mask);
+
+  // Trap on attempted double free
+  assert((old_word & slot_mask) == slot_mask);
+
+  // A word that was full has a free slot again
+  if(old_word == OCC_WORD_FULL) {
+    pool_index_t sm_word_idx = occ_map_word_offset / OCC_WORD_BITS;
+    OCC_FETCH_AND(&pool->block_summary_addr[i][sm_word_idx], ~(UINT64_C(1) << (occ_map_word_offset % OCC_WORD_BITS)));
+    if(sm_word_idx < HINT_LOAD(&pool->block_summary_hint[i])) {
+      HINT_STORE(&pool->block_summary_hint[i], sm_word_idx);
+    }
+  }
+}
+
+bool findFreeSlot(uint8_t* b_addr, pool_index_t* blk_free_loc, uint8_t block_size_idx) {
+  assert(f_pool_init);
+  return claimSlots(g_default_pool, b_addr, blk_free_loc, 1, block_size_idx) == 1;
+}
+
+/*
+ * Claims up to max_slots free slots of block-size region block_size_idx in one pass over its
+ * summary map, lowest first, and stores their slot numbers in blk_free_locs.
+ * Returns the number of slots claimed.
+ */
+static pool_index_t claimSlots(pool_t* pool, uint8_t* b_addr, pool_index_t* blk_free_locs, pool_index_t max_slots, uint8_t block_size_idx) {
+  uint64_t* occ_map = (uint64_t*)b_addr;
+  uint64_t* summary = pool->block_summary_addr[block_size_idx];
+  pool_index_t om_words = mapWords(pool, block_size_idx); // Word span of occupied map
+  pool_index_t sm_words = (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS;      // Word span of summary map
+  pool_index_t claimed = 0;
+  if(pool->placement == POOL_PLACE_NEXT_FIT) {
+    return claimSlotsNextFit(pool, block_size_idx, blk_free_locs, max_slots);
+  }
+  // Summary words below the hint are known to be full; large pools would otherwise rescan them on every call
+  pool_index_t* hint = &pool->block_summary_hint[block_size_idx];
+#ifdef POOL_THREAD_SAFE
+  // Search from this thread's start word, or from the hint if that lies further on, to the end of the map, then
+  // wrap around to the words before it. The hint is only advisory here: a word freed below it concurrently is
+  // still reached on the wrap-around.
+  pool_index_t hint_sm_idx = HINT_LOAD(hint) % sm_words;
+  pool_index_t start_word = t_scan_start % om_words;
+  if(start_word < hint_sm_idx * OCC_WORD_BITS) {
+    start_word = hint_sm_idx * OCC_WORD_BITS;
+  }
+  pool_index_t start_sm_idx = start_word / OCC_WORD_BITS;
+  uint64_t start_mask = OCC_WORD_FULL << (start_word % OCC_WORD_BITS);
+  for(pool_index_t step = 0; step <= sm_words; step++) {
+    pool_index_t sm_word_idx = (start_sm_idx + step) % sm_words;
+    uint64_t free_words = ~OCC_LOAD(&summary[sm_word_idx]);
+    if(step == 0) {
+      free_words &= start_mask;
+    } else if(step == sm_words) {
+      free_words &= ~start_mask;
+    }
+    if((free_words != 0) && (start_sm_idx == hint_sm_idx) && (sm_word_idx > hint_sm_idx)) {
+      // Every summary word from the hint up to this one was full
+      HINT_STORE(hint, sm_word_idx);
+    }
+#else
+  for(pool_index_t sm_word_idx = *hint + skipFullWords(summary + *hint, sm_words - *hint); sm_word_idx < sm_words; sm_word_idx++) {
+    uint64_t free_words = ~summary[sm_word_idx];
+    *hint = sm_word_idx;
+#endif
+    // Each clear summary bit names an occupation map word with a free slot, lowest first
+    while(free_words != 0) {
+      pool_index_t om_word_idx = sm_word_idx * OCC_WORD_BITS + __builtin_ctzll(free_words);
+      claimed += claimWordSlots(occ_map, summary, om_word_idx, blk_free_locs + claimed, max_slots - claimed);
+      if(claimed == max_slots) {
+        return claimed;
+      }
+      // The word is full now, either from this claim or from other threads
+      free_words &= free_words - 1;
+    }
+  }
+#ifndef POOL_THREAD_SAFE
+  *hint = sm_words;
+#endif
+  // Every occupation map word is full; no more open slots
+  return claimed;
+}
+
+/*
+ * Marks up to max_slots of the lowest free slots of occupation map word om_word_idx as used with a
+ * single update, and the word's summary bit once the word is full. Returns the number of slots
+ * claimed, which is lower than max_slots only when the word ran out of free slots.
+ */
+static pool_index_t claimWordSlots(uint64_t* occ_map, uint64_t* summary, pool_index_t om_word_idx, pool_index_t* blk_free_locs, pool_index_t max_slots) {
+  uint64_t* occ_map_word = &occ_map[om_word_idx];
+  uint64_t* summary_word = &summary[om_word_idx / OCC_WORD_BITS];
+  uint64_t summary_mask = UINT64_C(1) << (om_word_idx % OCC_WORD_BITS);
+  uint64_t old_word = OCC_LOAD(occ_map_word);
+  uint64_t claim_mask;
+  for(;;) {
+    // Gather the lowest free bits of the word
+    uint64_t free_bits = ~old_word;
+    claim_mask = 0;
+    for(pool_index_t k = 0; (k < max_slots) && (free_bits != 0); k++) {
+      claim_mask |= free_bits & -free_bits;
+      free_bits &= free_bits - 1;
+    }
+    if(claim_mask == 0) {
+#ifdef POOL_THREAD_SAFE
+      // The word filled up without its summary bit being set yet
+      markWordFull(occ_map_word, summary_word, summary_mask);
+#endif
+      return 0;
+    }
+#ifdef POOL_THREAD_SAFE
+    if(__atomic_compare_exchange_n(occ_map_word, &old_word, old_word | claim_mask, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      break;
+    }
+    // Lost the race for this word; start this thread's next search somewhere else
+    t_scan_start = nextScanStart();
+#else
+    *occ_map_word = old_word | claim_mask;
+    break;
+#endif
+  }
+
+  if((old_word | claim_mask) == OCC_WORD_FULL) {
+#ifdef POOL_THREAD_SAFE
+    markWordFull(occ_map_word, summary_word, summary_mask);
+#else
+    *summary_word |= summary_mask;
+#endif
+  }
+
+  pool_index_t claimed = 0;
+  while(claim_mask != 0) {
+    blk_free_locs[claimed++] = om_word_idx * OCC_WORD_BITS + __builtin_ctzll(claim_mask);
+    claim_mask &= claim_mask - 1;
+  }
+  return claimed;
+}
+
+/*
+ * Next-fit search of region i: claims up to max_slots free slots, lowest first within each occupation map word, from
+ * the word of the region's last claim to the end of the map, then wraps around to the words before it. The cursor
+ * then moves to the word the last slot came from. In thread-safe builds the cursor is only advisory, like the hint.
+ */
+static pool_index_t claimSlotsNextFit(pool_t* pool, uint8_t i, pool_index_t* blk_free_locs, pool_index_t max_slots) {
+  uint64_t* occ_map = (uint64_t*)pool->block_base_addr[i];
+  uint64_t* summary = pool->block_summary_addr[i];
+  pool_index_t om_words = mapWords(pool, i);
+  pool_index_t sm_words = (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+  pool_index_t start_word = HINT_LOAD(&pool->block_cursor[i]) % om_words;
+  pool_index_t start_sm_idx = start_word / OCC_WORD_BITS;
+  uint64_t start_mask = OCC_WORD_FULL << (start_word % OCC_WORD_BITS);
+  pool_index_t claimed = 0;
+  for(pool_index_t step = 0; step <= sm_words; step++) {
+    pool_index_t sm_word_idx = (start_sm_idx + step) % sm_words;
+    uint64_t free_words = ~OCC_LOAD(&summary[sm_word_idx]);
+    if(step == 0) {
+      free_words &= start_mask;
+    } else if(step == sm_words) {
+      free_words &= ~start_mask;
+    }
+    while(free_words != 0) {
+      pool_index_t om_word_idx = sm_word_idx * OCC_WORD_BITS + __builtin_ctzll(free_words);
+      claimed += claimWordSlots(occ_map, summary, om_word_idx, blk_free_locs + claimed, max_slots - claimed);
+      if(claimed == max_slots) {
+        HINT_STORE(&pool->block_cursor[i], om_word_idx);
+        return claimed;
+      }
+      free_words &= free_words - 1;
+    }
+  }
+  return claimed;
+}
+
+/*
+ * Claims the free slot of region i nearest to slot target: within target's occupation map word first, then
+ * the highest free slot of the word d below and the lowest of the word d above, for d up to NEAR_SEARCH_WORDS.
+ * Returns false, with nothing claimed, when every one of those words is full.
+ */
+static bool claimNearSlot(pool_t* pool, uint8_t i, pool_index_t target, pool_index_t* blk_free_loc) {
+  uint64_t* occ_map = (uint64_t*)pool->block_base_addr[i];
+  uint64_t* summary = pool->block_summary_addr[i];
+  pool_index_t om_words = mapWords(pool, i);
+  pool_index_t target_word = target / OCC_WORD_BITS;
+  unsigned target_bit = target % OCC_WORD_BITS;
+  for(pool_index_t d = 0; d <= NEAR_SEARCH_WORDS; d++) {
+    for(int above = 0; above < 2; above++) {
+      if(((d == 0) && above) || (!above && (d > target_word)) || (above && (d >= om_words - target_word))) {
+        continue;
+      }
+      pool_index_t om_word_idx = above ? target_word + d : target_word - d;
+      uint64_t* occ_map_word = &occ_map[om_word_idx];
+      uint64_t free_bits;
+      while((free_bits = ~OCC_LOAD(occ_map_word)) != 0) {
+        unsigned bit;
+        if(d > 0) {
+          bit = above ? __builtin_ctzll(free_bits) : OCC_WORD_BITS - 1 - __builtin_clzll(free_bits);
+        } else {
+          // Nearest free bit at or below target_bit against the nearest one above it
+          uint64_t low_bits = free_bits & ((UINT64_C(2) << target_bit) - 1);
+          uint64_t high_bits = free_bits & ~low_bits;
+          unsigned low = (low_bits != 0) ? OCC_WORD_BITS - 1 - __builtin_clzll(low_bits) : 0;
+          unsigned high = (high_bits != 0) ? __builtin_ctzll(high_bits) : 0;
+          bit = (high_bits == 0) || ((low_bits != 0) && (target_bit - low <= high - target_bit)) ? low : high;
+        }
+        uint64_t bit_mask = UINT64_C(1) << bit;
+        uint64_t old_word = OCC_FETCH_OR(occ_map_word, bit_mask);
+        if(old_word & bit_mask) {
+          // Another thread took the slot first; look at the word again
+          continue;
+        }
+        if((old_word | bit_mask) == OCC_WORD_FULL) {
+#ifdef POOL_THREAD_SAFE
+          markWordFull(occ_map_word, &summary[om_word_idx / OCC_WORD_BITS], UINT64_C(1) << (om_word_idx % OCC_WORD_BITS));
+#else
+          summary[om_word_idx / OCC_WORD_BITS] |= UINT64_C(1) << (om_word_idx % OCC_WORD_BITS);
+#endif
+        }
+        *blk_free_loc = om_word_idx * OCC_WORD_BITS + bit;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+#ifdef POOL_THREAD_SAFE
+/*
+ * Sets the summary bit of a full occupation map word. A free that lands between the word
+ * filling up and the summary update would leave the bit wrongly set, so re-check the word after.
+ */
+static void markWordFull(uint64_t* occ_map_word, uint64_t* summary_word, uint64_t summary_mask) {
+  OCC_FETCH_OR(summary_word, summary_mask);
+  if(OCC_LOAD(occ_map_word) != OCC_WORD_FULL) {
+    OCC_FETCH_AND(summary_word, ~summary_mask);
+  }
+}
+
+/*
+ * Picks a new search start word for the calling thread with a per-thread xorshift generator,
+ * so threads that collided on a word spread out over the occupation map.
+ */
+static pool_index_t nextScanStart(void) {
+  if(t_scan_seed == 0) {
+    t_scan_seed = (uint32_t)(uintptr_t)&t_scan_seed | 0x1;
+  }
+  t_scan_seed ^= t_scan_seed << 13;
+  t_scan_seed ^= t_scan_seed >> 17;
+  t_scan_seed ^= t_scan_seed << 5;
+  return (pool_index_t)t_scan_seed;
+}
+#endif
+
+#ifdef POOL_MAGAZINES
+/*
+ * Returns the calling thread's cache set for pool. A pool without one takes a free set, or
+ * evicts one round-robin after returning its slots to their pool. A set taken for an earlier
+ * pool at the same address is dropped: its slots belong to memory that pool no longer owns.
+ */
+static magazine_set_t* magazineSet(pool_t* pool) {
+  magazine_set_t* unused = NULL;
+  for(uint8_t k = 0; k < POOL_MAGAZINE_POOLS; k++) {
+    if(t_magazine_sets[k].pool == pool) {
+      if(t_magazine_sets[k].pool_id == pool->id) {
+        return &t_magazine_sets[k];
+      }
+      magazineDropSet(&t_magazine_sets[k]);
+    }
+    if((unused == NULL) && (t_magazine_sets[k].pool == NULL)) {
+      unused = &t_magazine_sets[k];
+    }
+  }
+  if(unused == NULL) {
+    unused = &t_magazine_sets[t_magazine_evict];
+    t_magazine_evict = (t_magazine_evict + 1) % POOL_MAGAZINE_POOLS;
+    magazineFlushSet(unused);
+  }
+  magazineRegister();
+  unused->pool = pool;
+  unused->pool_id = pool->id;
+  return unused;
+}
 
-  for(uint8_t i = 0; i < block_size_count; i++) {
-    if((block_sizes[i] == 0) || (block_sizes[i] > MAX_HEAP_SIZE)){
-      // Invalid list entry
-      return false;
+/*
+ * Hands out a slot of block-size region i from the calling thread's cache, refilling the cache
+ * with one claimSlots pass when it is empty. Returns NULL when the region has no free slot left.
+ */
+static uint8_t* magazinePop(pool_t* pool, uint8_t i) {
+  magazine_set_t* set = magazineSet(pool);
+  magazine_t* mag = &set->magazines[i];
+  if(mag->count > 0) {
+    set->stats.alloc_hits++;
+    mag->allocs++;
+    if(++set->unfolded_ops == MAGAZINE_FOLD_OPS) {
+      magazineFoldStats(set);
     }
+    return mag->slots[--mag->count];
   }
 
-  uint8_t* heap_ptr = g_pool_heap;    // Pointer to current heap usage
-  num_block_size = block_size_count;
+  pool_index_t locs[MAGAZINE_BATCH];
+  pool_index_t claimed = claimSlots(pool, pool->block_base_addr[i], locs, MAGAZINE_BATCH, i);
+  uint8_t* slot_base = slotBase(pool, i);
+  // Stack the batch so that the lowest slot is handed out first
+  for(pool_index_t k = claimed; k > 0; k--) {
+    mag->slots[mag->count++] = slot_base + locs[k - 1] * pool->block_sizes_list[i];
+  }
+  set->stats.alloc_refills++;
+  if(mag->count > 0) {
+    mag->allocs++;
+  }
+  magazineFoldStats(set);
+  return (mag->count > 0) ? mag->slots[--mag->count] : NULL;
+}
 
-  // Copy over block size list
-  block_sizes_list = (uint16_t*)heap_ptr;
-  for(uint8_t i = 0; i < num_block_size; i++){
-    if(block_sizes[i] >= MAX_HEAP_SIZE) {
-      // Invalid input
-      return false;
+/*
+ * Caches a freed slot of block-size region i in the calling thread's cache. A full cache first
+ * returns its older half to the occupation map.
+ */
+static void magazinePush(pool_t* pool, uint8_t i, uint8_t* ptr) {
+  magazine_set_t* set = magazineSet(pool);
+  magazine_t* mag = &set->magazines[i];
+#ifndef NDEBUG
+  // Trap on double free; a slot cached twice would be handed out twice long before a flush reaches the occupation map
+  for(uint16_t k = 0; k < mag->count; k++) {
+    assert(mag->slots[k] != ptr);
+  }
+#endif
+  if(mag->count == POOL_MAGAZINE_SIZE) {
+    for(uint16_t k = 0; k < MAGAZINE_BATCH; k++) {
+      freeSlot(pool, i, mag->slots[k]);
+    }
+    for(uint16_t k = MAGAZINE_BATCH; k < POOL_MAGAZINE_SIZE; k++) {
+      mag->slots[k - MAGAZINE_BATCH] = mag->slots[k];
     }
-    *((uint16_t*)heap_ptr) = (uint16_t)(block_sizes[i]);
-    heap_ptr += sizeof(uint16_t);
+    mag->count -= MAGAZINE_BATCH;
+    set->stats.free_flushes++;
+    magazineFoldStats(set);
   }
-  insertionSort(block_sizes_list, num_block_size);
-  // block_sizes configuration with 1 slice per block-size does not fit g_heap_pool
-  assert(heap_ptr < g_pool_heap + sizeof(uint8_t) * MAX_HEAP_SIZE);
-
-  block_offset_list = (uint16_t*)heap_ptr;
+  mag->slots[mag->count++] = ptr;
+  set->stats.free_hits++;
+  mag->frees++;
+  if(++set->unfolded_ops == MAGAZINE_FOLD_OPS) {
+    magazineFoldStats(set);
+  }
+}
 
-  // Initialize temporary counts array in heap (use the offset list region)
-  uint16_t* temp_block_counts = block_offset_list;
-  for(uint8_t i = 0; i < num_block_size; i++){
-    *((uint16_t*)heap_ptr) = 0;
-    heap_ptr += sizeof(uint16_t);
+/*
+ * Returns every slot cached in set to its pool's occupation maps and releases the set. A set whose
+ * pool was destroyed, or replaced by another one at the same address, is dropped instead.
+ */
+static void magazineFlushSet(magazine_set_t* set) {
+  if(set->pool == NULL) {
+    return;
   }
-  assert(heap_ptr < g_pool_heap + sizeof(uint8_t) * MAX_HEAP_SIZE);
+  if(__atomic_load_n(&set->pool->id, __ATOMIC_RELAXED) != set->pool_id) {
+    magazineDropSet(set);
+    return;
+  }
+  for(uint8_t i = 0; i < POOL_MAGAZINE_CLASSES; i++) {
+    magazine_t* mag = &set->magazines[i];
+    while(mag->count > 0) {
+      freeSlot(set->pool, i, mag->slots[--mag->count]);
+    }
+  }
+  magazineFoldStats(set);
+  set->pool = NULL;
+}
 
-  // Available = MAX - block_size_list - offset_list - base_addr_list
-  uint16_t available_bytes = MAX_HEAP_SIZE - num_block_size * (sizeof(uint16_t) + sizeof(uint16_t)+sizeof(uint8_t*));
+/*
+ * Forgets the slots and counts cached in set without touching its pool, and releases the set.
+ */
+static void magazineDropSet(magazine_set_t* set) {
+  for(uint8_t i = 0; i < POOL_MAGAZINE_CLASSES; i++) {
+    set->magazines[i] = (magazine_t){0};
+  }
+  set->stats = (pool_magazine_stats_t){0};
+  set->unfolded_ops = 0;
+  set->pool = NULL;
+}
 
-  // Try to evenly allocate blocks
-  while(available_bytes > 0) {
-    // Iterate through block_sizes_list to create regions
-    for(uint8_t i = 0; i < num_block_size; i++) {
-      if(available_bytes >= block_sizes_list[i]) {
-        if(temp_block_counts[i] % 8 == 0){
-          // A new memory bitmap byte is needed
-          // Make sure that the block fits with at least 1 more byte
-          if(available_bytes > block_sizes_list[i]) {
-            available_bytes -= 1;
-          } else {
-            break; // No more space to hold extra bitmap byte; forgo last block
-          }
-        }
-        temp_block_counts[i] += 1;
-        available_bytes -= block_sizes_list[i];
-      } else {
-        if(temp_block_counts[i] == 0){
-          // ERROR: Not all block sizes could be allocated
-          return false;
-        } else if (available_bytes < block_sizes_list[0]){
-          // Remaining space cannot fit the smallest block
-          available_bytes = 0;
-          break;
-        }
-      }
+/*
+ * Returns the slots the calling thread caches for pool to its occupation maps.
+ */
+static void magazineFlushPool(pool_t* pool) {
+  for(uint8_t k = 0; k < POOL_MAGAZINE_POOLS; k++) {
+    if(t_magazine_sets[k].pool == pool) {
+      magazineFlushSet(&t_magazine_sets[k]);
     }
   }
+}
 
-  block_base_addr = (uint8_t **) heap_ptr;
-  heap_ptr += sizeof(uint8_t*) * num_block_size;
+static void magazineThreadExit(void* arg) {
+  (void)arg;
+  pool_magazine_flush();
+}
 
-  // Prepare memory regions
-  for(uint8_t i = 0; i < num_block_size; i++) {
-    uint16_t occmap_num_bytes = temp_block_counts[i] / 8;
-    uint8_t occmap_remainder = temp_block_counts[i] % 8;
+static void magazineCreateKey(void) {
+  pthread_key_create(&g_magazine_key, magazineThreadExit);
+}
 
-    ((uint8_t**)block_base_addr)[i] = heap_ptr;
+/*
+ * Registers the calling thread's caches to be flushed back to the occupation maps on thread exit.
+ */
+static void magazineRegister(void) {
+  if(!t_magazine_registered) {
+    pthread_once(&g_magazine_key_once, magazineCreateKey);
+    pthread_setspecific(g_magazine_key, &t_magazine_registered);  // Any non-NULL value runs the destructor
+    t_magazine_registered = true;
+  }
+}
 
-    // Populate memory occupation map
-    for(uint16_t j = 0; j < occmap_num_bytes; j++) {
-      ((uint8_t*)heap_ptr)[j] = 0;
+/*
+ * Adds the calling thread's counters for one pool to that pool's totals. Only runs on refills,
+ * flushes, queries and every MAGAZINE_FOLD_OPS cache hits, so that cache hits rarely touch shared cache lines.
+ */
+static void magazineFoldStats(magazine_set_t* set) {
+  pool_t* pool = set->pool;
+  pool_magazine_stats_t* totals = &pool->magazine_stats;
+  __atomic_fetch_add(&totals->alloc_hits, set->stats.alloc_hits, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&totals->alloc_refills, set->stats.alloc_refills, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&totals->free_hits, set->stats.free_hits, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&totals->free_flushes, set->stats.free_flushes, __ATOMIC_RELAXED);
+  set->stats = (pool_magazine_stats_t){0};
+
+  for(uint8_t i = 0; (i < POOL_MAGAZINE_CLASSES) && (i < pool->num_block_size); i++) {
+    magazine_t* mag = &set->magazines[i];
+    // Frees first, so that live never overshoots the high-water mark
+    if(mag->frees > 0) {
+      statsCountFrees(&pool->region_stats[i], mag->frees);
+      mag->frees = 0;
+    }
+    if(mag->allocs > 0) {
+      statsCountAllocs(&pool->region_stats[i], mag->allocs);
+      mag->allocs = 0;
     }
+  }
+  set->unfolded_ops = 0;
+}
+#endif
 
-    // Calculate occupied map offset and populate last byte of occupation map
-    if(occmap_remainder > 0) {
-      occmap_num_bytes += 1;
-      uint8_t remainder_map = 0;
-      for(int8_t k = occmap_remainder - 1; k >= 0 ; k--){
-        remainder_map |= (0x1 << k);
+#ifdef POOL_SPLIT
+/*
+ * Takes a sub-slot of block size fit from a split slot: a free one of a slot split for fit already, or else
+ * the first of a slot newly split from the smallest region below end that has a free slot holding at least
+ * two sub-slots. Returns NULL when neither is possible, or the split table is full; otherwise parent receives
+ * the entry of the split slot, whose region and slot the trace records for the sub-slot.
+ */
+static uint8_t* splitClaim(pool_t* pool, uint8_t fit, uint8_t end, split_slot_t** parent) {
+  pool_index_t sub_size = pool->block_sizes_list[fit];
+  split_slot_t* free_entry = NULL;
+  for(size_t k = 0; k < POOL_SPLIT_SLOTS; k++) {
+    split_slot_t* split = &pool->splits[k];
+    if(split->used == 0) {
+      if(free_entry == NULL) {
+        free_entry = split;
       }
-      ((uint8_t*)heap_ptr)[occmap_num_bytes - 1] = ~remainder_map;
+      continue;
+    }
+    uint64_t free_bits = ~split->used & ((split->sub_count < OCC_WORD_BITS) ? (UINT64_C(1) << split->sub_count) - 1 : OCC_WORD_FULL);
+    if((split->sub_region == fit) && (split->region < end) && (free_bits != 0)) {
+      unsigned sub = __builtin_ctzll(free_bits);
+      split->used |= UINT64_C(1) << sub;
+      pool->split_stats.borrows++;
+      *parent = split;
+      return slotBase(pool, split->region) + (size_t)split->slot * pool->block_sizes_list[split->region] + sub * sub_size;
+    }
+  }
+  if(free_entry == NULL) {
+    pool->split_stats.table_full++;
+    return NULL;
+  }
+  for(uint8_t j = fit + 1; j < end; j++) {
+    size_t sub_count = pool->block_sizes_list[j] / sub_size;
+    pool_index_t slot;
+    if((sub_count < 2) || (claimSlots(pool, pool->block_base_addr[j], &slot, 1, j) != 1)) {
+      continue;
+    }
+    statsCountAllocs(&pool->region_stats[j], 1);
+    *free_entry = (split_slot_t){
+      .used = 1,
+      .slot = slot,
+      .region = j,
+      .sub_region = fit,
+      .sub_count = (sub_count < OCC_WORD_BITS) ? sub_count : OCC_WORD_BITS,
+    };
+    pool->split_stats.splits++;
+    pool->split_stats.split_slots++;
+    pool->split_stats.borrows++;
+    *parent = free_entry;
+    return slotBase(pool, j) + (size_t)slot * pool->block_sizes_list[j];
+  }
+  return NULL;
+}
+
+/*
+ * Split table entry of the slot ptr lies in; NULL when ptr lies in no split slot. sub receives the sub-slot
+ * ptr is the start of, or SIZE_MAX when ptr lies between sub-slots or in the tail past the last one.
+ */
+static split_slot_t* splitFind(pool_t* pool, uint8_t* ptr, size_t* sub) {
+  if((pool->split_stats.split_slots == 0) || (ptr < slotBase(pool, 0)) || (ptr >= pool->alloc_end_addr)) {
+    return NULL;
+  }
+  uint8_t i = regionIndex(pool, ptr);
+  if(ptr < slotBase(pool, i)) {
+    return NULL;
+  }
+  size_t slot = (ptr - slotBase(pool, i)) / pool->block_sizes_list[i];
+  for(size_t k = 0; k < POOL_SPLIT_SLOTS; k++) {
+    split_slot_t* split = &pool->splits[k];
+    if((split->used != 0) && (split->region == i) && (split->slot == slot)) {
+      size_t offset = (ptr - slotBase(pool, i)) % pool->block_sizes_list[i];
+      pool_index_t sub_size = pool->block_sizes_list[split->sub_region];
+      *sub = ((offset % sub_size == 0) && (offset / sub_size < split->sub_count)) ? offset / sub_size : SIZE_MAX;
+      return split;
     }
+  }
+  return NULL;
+}
 
-    heap_ptr += sizeof(uint8_t) * occmap_num_bytes + temp_block_counts[i] * block_sizes_list[i];
-    // Set occupied map offset from block_base_addr
-    block_offset_list[i] = occmap_num_bytes;
+/*
+ * Frees ptr if it is a sub-slot, handing its slot back to the region whole once no sub-slot of it is in use.
+ * Returns false when ptr lies in no split slot.
+ */
+static bool splitRelease(pool_t* pool, uint8_t* ptr) {
+  size_t sub;
+  split_slot_t* split = splitFind(pool, ptr, &sub);
+  if(split == NULL) {
+    return false;
+  }
+  // Trap on pointers between sub-slots, and on double frees
+  assert(sub != SIZE_MAX);
+  uint64_t sub_mask = UINT64_C(1) << sub;
+  assert(split->used & sub_mask);
+  split->used &= ~sub_mask;
+  TRACE_EVENT(pool, POOL_TRACE_FREE, split->region, ptr, 0, split->slot);
+  if(split->used == 0) {
+    uint8_t* slot_ptr = slotBase(pool, split->region) + (size_t)split->slot * pool->block_sizes_list[split->region];
+    if(freeSlot(pool, split->region, slot_ptr)) {
+      statsCountFrees(&pool->region_stats[split->region], 1);
+    }
+    pool->split_stats.merges++;
+    pool->split_stats.split_slots--;
   }
-  alloc_end_addr = heap_ptr;
-  f_pool_init = true; // Pool is initialized
   return true;
 }
+#endif
 
+#ifndef POOL_THREAD_SAFE
+/*
+ * Returns the index of the first map word that may hold a clear bit.
+ * The SIMD paths compare several words against all-ones per iteration; without --enable-simd
+ * the search is left to claimSlots. Thread-safe builds scan from a per-thread start word and
+ * never call this.
+ */
+static pool_index_t skipFullWords(const uint64_t* map, pool_index_t map_words) {
+  pool_index_t word_idx = 0;
+#if defined(POOL_USE_SIMD) && defined(__AVX2__)
+  const __m256i full = _mm256_set1_epi64x(-1);
+  for(; word_idx + 4 <= map_words; word_idx += 4) {
+    __m256i words = _mm256_loadu_si256((const __m256i*)(map + word_idx));
+    if(_mm256_movemask_epi8(_mm256_cmpeq_epi64(words, full)) != -1) {
+      break;
+    }
+  }
+#elif defined(POOL_USE_SIMD) && defined(__SSE2__)
+  const __m128i full = _mm_set1_epi32(-1);
+  for(; word_idx + 2 <= map_words; word_idx += 2) {
+    __m128i words = _mm_loadu_si128((const __m128i*)(map + word_idx));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(words, full)) != 0xFFFF) {
+      break;
+    }
+  }
+#else
+  (void)map;
+  (void)map_words;
+#endif
+  return word_idx;
+}
+#endif
 
-void* pool_malloc(size_t n){
-  // Validate input
-  assert(f_pool_init); // Trap on attempt to malloc before pool initialization
-  if((n == 0 ) || (n > block_sizes_list[num_block_size-1])) {
-    // Invalid request size
-    return NULL;
+#ifdef POOL_HISTOGRAM
+/*
+ * Histogram bucket of a request of n bytes; sizes past the largest bucket share it.
+ */
+static size_t histogramIndex(size_t n) {
+  if(n <= HIST_DIRECT_MAX) {
+    return n;
   }
+  uint8_t log2 = 63 - __builtin_clzll(n - 1);
+  if(log2 >= CLASS_LOG_MAX) {
+    return HIST_BUCKETS - 1;
+  }
+  uint8_t sub = ((n - 1) >> (log2 - HIST_LOG_SUBBUCKET_BITS)) & (HIST_LOG_SUBBUCKETS - 1);
+  return HIST_DIRECT_MAX + 1 + (log2 - HIST_LOG_MIN) * HIST_LOG_SUBBUCKETS + sub;
+}
 
-  if(n > block_sizes_list[num_block_size - 1]) {
-    // Requested size greater than allocable block
-#ifdef DEBUG
-    printf("[TMA] Requested size greater than largest block size!\n");
+/*
+ * Largest request size that falls in histogram bucket idx.
+ */
+static size_t histogramBucketSize(size_t idx) {
+  if(idx <= HIST_DIRECT_MAX) {
+    return idx;
+  }
+  size_t log2 = HIST_LOG_MIN + (idx - HIST_DIRECT_MAX - 1) / HIST_LOG_SUBBUCKETS;
+  size_t sub = (idx - HIST_DIRECT_MAX - 1) % HIST_LOG_SUBBUCKETS;
+  return ((size_t)1 << log2) + ((sub + 1) << (log2 - HIST_LOG_SUBBUCKET_BITS));
+}
 #endif
-    return NULL;
+
+/*
+ * Fills class_lookup from the sorted block_sizes_list. Direct entries hold the smallest
+ * fitting block for each request size; log-spaced entries hold the smallest block that fits
+ * the lowest request size of their bucket.
+ */
+static void buildClassLookup(pool_t* pool) {
+  pool_index_t* block_sizes_list = pool->block_sizes_list;
+  uint8_t* class_lookup = pool->class_lookup;
+  uint8_t i = 0;
+  for(size_t n = 1; n <= CLASS_DIRECT_MAX; n++) {
+    while((i < pool->num_block_size) && (block_sizes_list[i] < n)) {
+      i++;
+    }
+    class_lookup[n] = i;
+  }
+  class_lookup[0] = class_lookup[1];
+
+  for(uint8_t log2 = CLASS_LOG_MIN; log2 < CLASS_LOG_MAX; log2++) {
+    for(uint8_t sub = 0; sub < CLASS_LOG_SUBBUCKETS; sub++) {
+      size_t bucket_min = ((size_t)1 << log2) + ((size_t)sub << (log2 - CLASS_LOG_SUBBUCKET_BITS)) + 1;
+      while((i < pool->num_block_size) && (block_sizes_list[i] < bucket_min)) {
+        i++;
+      }
+      class_lookup[CLASS_DIRECT_MAX + 1 + (log2 - CLASS_LOG_MIN) * CLASS_LOG_SUBBUCKETS + sub] = i;
+    }
+  }
+}
+
+/*
+ * Index of the smallest block size that fits n bytes. n must not exceed the largest block size.
+ */
+static uint8_t sizeClassIndex(const pool_t* pool, size_t n) {
+  if(n <= CLASS_DIRECT_MAX) {
+    return pool->class_lookup[n];
   }
+  uint8_t log2 = 63 - __builtin_clzll(n - 1);
+  uint8_t sub = ((n - 1) >> (log2 - CLASS_LOG_SUBBUCKET_BITS)) & (CLASS_LOG_SUBBUCKETS - 1);
+  uint8_t i = pool->class_lookup[CLASS_DIRECT_MAX + 1 + (log2 - CLASS_LOG_MIN) * CLASS_LOG_SUBBUCKETS + sub];
+  // A bucket spans a quarter of a power of two; step past the few block sizes inside it that are too small
+  while(pool->block_sizes_list[i] < n) {
+    i++;
+  }
+  return i;
+}
 
-  // Find the smallest block that fits the data
+/*
+ * Fills region_lookup so that each entry holds the last block-size region starting at or
+ * before the first byte that entry covers.
+ */
+static void buildRegionLookup(pool_t* pool) {
   uint8_t i = 0;
-  for(; i < num_block_size; i++) {
-    // Try to find a free slot in the smallest block size that will fit the request
-    uint16_t free_slot_loc = 0;
-    uint8_t* base_addr = block_base_addr[i];
-    if((block_sizes_list[i] >= n) && (findFreeSlot(base_addr, &free_slot_loc, i))) {
-      // Calculate the location of the free slot
-      return (void*) (base_addr + block_offset_list[i] + free_slot_loc * block_sizes_list[i]);
+  size_t entries = (pool->heap_len + (1 << REGION_LOOKUP_SHIFT) - 1) >> REGION_LOOKUP_SHIFT;
+  for(size_t entry = 0; entry < entries; entry++) {
+    uint8_t* entry_addr = pool->heap_start + (entry << REGION_LOOKUP_SHIFT);
+    while(((size_t)i + 1 < pool->num_block_size) && (slotBase(pool, i + 1) <= entry_addr)) {
+      i++;
     }
+    pool->region_lookup[entry] = i;
   }
-   // ERROR: Did not find a block that fit the requested size
-   return NULL;
 }
 
-void pool_free(void* ptr){
-  assert(f_pool_init);  // Trap on attempt to free before pool initialization
+/*
+ * Index of the block-size region holding ptr. ptr must lie between the first slot and alloc_end_addr.
+ */
+static uint8_t regionIndex(const pool_t* pool, uint8_t* ptr) {
+  uint8_t i = pool->region_lookup[(ptr - pool->heap_start) >> REGION_LOOKUP_SHIFT];
+  // Only regions that start inside the same lookup entry need stepping past
+  while(((size_t)i + 1 < pool->num_block_size) && (ptr >= slotBase(pool, i + 1))) {
+    i++;
+  }
+  return i;
+}
 
-  if((ptr == NULL) || ((uint8_t*)ptr < g_pool_heap) || ((uint8_t*)ptr > alloc_end_addr)) {
-#ifdef DEBUG
-    printf("[TMA] Invalid pointer %p to free!\n", ptr);
+/*
+ * Header in front of a pool from pool_create_file or pool_attach.
+ */
+static pool_file_header_t* fileHeader(pool_t* pool) {
+  assert(pool != NULL);
+  pool_file_header_t* header = (pool_file_header_t*)((uint8_t*)pool - POOL_FILE_HEADER_LEN);
+  assert(header->magic == POOL_FILE_MAGIC);  // Trap on pools that are not file-backed
+  return header;
+}
+
+/*
+ * Checks that a mapped pool file was written by a build with the same layout, and that every pointer in the pool
+ * lands inside the file once moved from header->base to the mapping. Nothing is written.
+ */
+static bool validPoolFile(const pool_file_header_t* header, const pool_t* pool) {
+  if((header->pool_len != sizeof(pool_t)) || (header->index_len != sizeof(pool_index_t)) || (header->stats_len != sizeof(pool_region_stats_t))
+     || (header->region_lookup_shift != REGION_LOOKUP_SHIFT) || (header->num_block_size == 0) || (header->num_block_size > UCHAR_MAX)
+     || (pool->num_block_size != header->num_block_size) || (pool->heap_len != header->file_len - POOL_FILE_HEADER_LEN)
+     || ((uintptr_t)pool->heap_start != header->base + POOL_FILE_HEADER_LEN)) {
+    return false;
+  }
+  // Offsets from the pool start, as the pointers were stored against header->base
+  uintptr_t start = (uintptr_t)pool->heap_start;
+  size_t n = pool->num_block_size;
+  const struct {
+    const void* ptr;
+    size_t len;
+  } spans[] = {
+    {pool->class_lookup, CLASS_LOOKUP_ENTRIES},
+    {pool->region_lookup, (pool->heap_len + (1 << REGION_LOOKUP_SHIFT) - 1) >> REGION_LOOKUP_SHIFT},
+    {pool->block_summary_hint, n * sizeof(pool_index_t)},
+    {pool->block_summary_addr, n * sizeof(uint64_t*)},
+    {pool->region_stats, n * sizeof(pool_region_stats_t)},
+    {pool->block_sizes_list, n * sizeof(pool_index_t)},
+    {pool->block_offset_list, n * sizeof(pool_index_t)},
+    {pool->block_base_addr, n * sizeof(uint8_t*)},
+    {pool->alloc_end_addr, 0},
+  };
+  for(size_t k = 0; k < sizeof(spans) / sizeof(spans[0]); k++) {
+    uintptr_t offset = (uintptr_t)spans[k].ptr - start;
+    if(((uintptr_t)spans[k].ptr < start) || (offset > pool->heap_len) || (spans[k].len > pool->heap_len - offset)) {
+      return false;
+    }
+  }
+  // The per-region pointer arrays, read at their offsets inside this mapping
+  uint8_t* mapped = (uint8_t*)pool;
+  uint64_t** summary_addr = (uint64_t**)(mapped + ((uintptr_t)pool->block_summary_addr - start));
+  uint8_t** base_addr = (uint8_t**)(mapped + ((uintptr_t)pool->block_base_addr - start));
+  pool_region_stats_t* stats = (pool_region_stats_t*)(mapped + ((uintptr_t)pool->region_stats - start));
+  for(size_t i = 0; i < n; i++) {
+    uintptr_t summary_offset = (uintptr_t)summary_addr[i] - start;
+    uintptr_t base_offset = (uintptr_t)base_addr[i] - start;
+    size_t om_words = (stats[i].capacity + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+    if(((uintptr_t)summary_addr[i] < start) || (summary_offset > pool->heap_len) || ((uintptr_t)base_addr[i] < start) || (base_offset > pool->heap_len)
+       || (om_words * sizeof(uint64_t) > pool->heap_len - base_offset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Moves every pointer of a pool whose memory was at old_base to the same offset from new_base.
+ */
+static void rebasePool(pool_t* pool, uint8_t* old_base, uint8_t* new_base) {
+#define REBASE(p) ((p) = (void*)((uint8_t*)(p) - old_base + new_base))
+  REBASE(pool->heap_start);
+  REBASE(pool->class_lookup);
+  REBASE(pool->region_lookup);
+  REBASE(pool->block_summary_hint);
+  REBASE(pool->block_cursor);
+#ifdef POOL_SPLIT
+  REBASE(pool->splits);
 #endif
-    return;  // Invalid pointer
+  REBASE(pool->block_summary_addr);
+  REBASE(pool->region_stats);
+  REBASE(pool->block_sizes_list);
+  REBASE(pool->block_offset_list);
+  REBASE(pool->block_base_addr);
+  REBASE(pool->alloc_end_addr);
+  for(size_t i = 0; i < pool->num_block_size; i++) {
+    REBASE(pool->block_summary_addr[i]);
+    REBASE(pool->block_base_addr[i]);
   }
+#undef REBASE
+}
 
-  // Find which block the pointer belongs to
-  for(uint8_t i = num_block_size - 1; i >= 0; i--) {
-    uint8_t* base_addr = block_base_addr[i];
-    if((uint8_t*)ptr >= base_addr + block_offset_list[i]) {
-      // Check occupation map for pointer
-      uint16_t ptr_alloc_offset = (uint8_t*)ptr - (base_addr + block_offset_list[i]);
+/*
+ * Index of the block-size region whose slot starts at ptr; num_block_size when ptr is NULL, outside the
+ * slots or not at the start of a slot.
+ */
+static uint8_t slotRegion(const pool_t* pool, uint8_t* ptr) {
+  if((ptr == NULL) || (ptr < slotBase(pool, 0)) || (ptr >= pool->alloc_end_addr)) {
+    return pool->num_block_size;
+  }
+  uint8_t i = regionIndex(pool, ptr);
+  size_t offset = ptr - slotBase(pool, i);
+  if((offset % pool->block_sizes_list[i] != 0) || (offset / pool->block_sizes_list[i] >= pool->region_stats[i].capacity)) {
+    return pool->num_block_size;
+  }
+  return i;
+}
 
-      // Trap if the pointer is unaligned
-      assert(ptr_alloc_offset % block_sizes_list[i] == 0);
+/*
+ * Slot alignment for a block size and its alignment setting: POOL_ALIGN_NATURAL picks the largest power
+ * of two dividing the block size, up to 16, which suits any type of that size.
+ * Returns 0 when alignment is not a power of two up to POOL_ALIGN_MAX.
+ */
+static size_t resolveAlignment(size_t block_size, size_t alignment) {
+  if(alignment == POOL_ALIGN_NATURAL) {
+    alignment = (size_t)1 << __builtin_ctzll(block_size);
+    return (alignment < 16) ? alignment : 16;
+  }
+  if(((alignment & (alignment - 1)) != 0) || (alignment > POOL_ALIGN_MAX)) {
+    return 0;
+  }
+  return alignment;
+}
 
-      uint16_t occ_map_bit_offset = ptr_alloc_offset / (block_sizes_list[i]);
-      uint16_t occ_map_byte_offset = occ_map_bit_offset / 8;
-      uint8_t  last_byte_bit_offset = occ_map_bit_offset % 8;
+/*
+ * Bytes needed to grow a region by one block: the block itself, the padding that keeps
+ * the next region word-aligned, a new occupation map word every OCC_WORD_BITS blocks
+ * and a new summary word every OCC_SUMMARY_SPAN blocks.
+ */
+static size_t regionGrowthCost(pool_index_t block_count, pool_index_t block_size) {
+  size_t cost = ALIGN_WORD((size_t)(block_count + 1) * block_size) - ALIGN_WORD((size_t)block_count * block_size);
+  if(block_count % OCC_WORD_BITS == 0) {
+    cost += sizeof(uint64_t);
+  }
+  if(block_count % OCC_SUMMARY_SPAN == 0) {
+    cost += sizeof(uint64_t);
+  }
+  return cost;
+}
 
-      // Trap on attempted double free
-      assert(((*(base_addr + occ_map_byte_offset)) >> last_byte_bit_offset) & 0x1);
+/*
+ * Bytes taken by a region of block_count blocks: its occupation map words, the blocks padded to a
+ * word, and its summary words. Equal to the sum of regionGrowthCost over every block.
+ */
+static size_t regionBytes(size_t block_count, pool_index_t block_size) {
+  size_t om_words = (block_count + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+  return sizeof(uint64_t) * (om_words + (om_words + OCC_WORD_BITS - 1) / OCC_WORD_BITS) + ALIGN_WORD(block_count * block_size);
+}
 
-      // Set the occupation map bit to 0
-      *(base_addr + occ_map_byte_offset) = *(base_addr + occ_map_byte_offset) & ((uint8_t)~(0x1 << (last_byte_bit_offset)));
-      break;
+/*
+ * Adds one block to each region in turn until a full pass cannot grow any region.
+ * Returns the bytes left over.
+ */
+static size_t growRegionsEvenly(const pool_index_t* block_sizes_list, pool_index_t* block_counts, size_t num_block_size, size_t available_bytes) {
+  bool region_grown = true;
+  while(region_grown) {
+    region_grown = false;
+    // Iterate through block_sizes_list to create regions
+    for(uint8_t i = 0; i < num_block_size; i++) {
+      size_t cost = regionGrowthCost(block_counts[i], block_sizes_list[i]);
+      if(available_bytes >= cost) {
+        block_counts[i] += 1;
+        available_bytes -= cost;
+        region_grown = true;
+      }
     }
   }
+  return available_bytes;
 }
 
-// Helper functions
-bool findFreeSlot(uint8_t* b_addr, uint16_t* blk_free_loc, uint8_t block_size_idx) {
-  uint16_t om_size = block_offset_list[block_size_idx]; // Byte span of occupied map
-  uint16_t free_loc = 0;
-  for(uint16_t om_byte_idx = 0; om_byte_idx < om_size; om_byte_idx++) {
-    uint8_t om_byte_val = (uint8_t) *(b_addr + om_byte_idx);
-    if(om_byte_val != 255){
-      // There is a free slot in this byte slice mapping
-      for(uint8_t i = 0; i < 8; i++){
-        if(om_byte_val & 0x1) {
-          // Slot is occupied
-          free_loc++;
-          om_byte_val = om_byte_val >> 0x1;
+/*
+ * Fills block_counts from targets (in sorted region order) as sizing says, within available_bytes.
+ * Returns false when a target is zero or the targets do not fit.
+ */
+static bool sizeRegions(const pool_index_t* block_sizes_list, const size_t* targets, size_t num_block_size, pool_sizing_t sizing, size_t available_bytes, pool_index_t* block_counts) {
+  size_t used_bytes = 0;
+  double weight_sum = 0;
+  for(uint8_t i = 0; i < num_block_size; i++) {
+    if(targets[i] == 0) {
+      return false;
+    }
+    weight_sum += targets[i];
+  }
+
+  switch(sizing) {
+    case POOL_SIZE_BY_WEIGHT: {
+      // Largest total block count whose weighted split fits, then hand the remainder out evenly
+      size_t lo = 0;
+      size_t hi = available_bytes;
+      while(lo < hi) {
+        size_t total = lo + (hi - lo + 1) / 2;
+        size_t bytes = 0;
+        for(uint8_t i = 0; (i < num_block_size) && (bytes <= available_bytes); i++) {
+          bytes += regionBytes((size_t)((double)total * targets[i] / weight_sum), block_sizes_list[i]);
+        }
+        if(bytes <= available_bytes) {
+          lo = total;
         } else {
-          // Slot free, mark as used now
-          *(b_addr + om_byte_idx) = (*(b_addr + om_byte_idx)) | (0x1 << i);
-          *blk_free_loc = free_loc;
+          hi = total - 1;
+        }
+      }
+      for(uint8_t i = 0; i < num_block_size; i++) {
+        block_counts[i] = (pool_index_t)((double)lo * targets[i] / weight_sum);
+        used_bytes += regionBytes(block_counts[i], block_sizes_list[i]);
+      }
+      // Grow the region furthest below its share that still fits, one block at a time
+      for(;;) {
+        int16_t next = -1;
+        for(uint8_t i = 0; i < num_block_size; i++) {
+          if((regionGrowthCost(block_counts[i], block_sizes_list[i]) <= available_bytes - used_bytes)
+             && ((next < 0) || ((double)block_counts[i] / targets[i] < (double)block_counts[next] / targets[next]))) {
+            next = i;
+          }
+        }
+        if(next < 0) {
           return true;
         }
+        used_bytes += regionGrowthCost(block_counts[next], block_sizes_list[next]);
+        block_counts[next] += 1;
       }
-    } else {
-      free_loc += 8;
     }
+    case POOL_SIZE_BY_COUNT:
+      for(uint8_t i = 0; i < num_block_size; i++) {
+        if((targets[i] > available_bytes / block_sizes_list[i]) || (used_bytes > available_bytes)) {
+          return false;
+        }
+        block_counts[i] = (pool_index_t)targets[i];
+        used_bytes += regionBytes(block_counts[i], block_sizes_list[i]);
+      }
+      return used_bytes <= available_bytes;
+    case POOL_SIZE_BY_BYTES:
+      for(uint8_t i = 0; i < num_block_size; i++) {
+        // Largest block count whose region fits the byte budget
+        size_t lo = 0;
+        size_t hi = ((targets[i] < available_bytes) ? targets[i] : available_bytes) / block_sizes_list[i];
+        while(lo < hi) {
+          size_t count = lo + (hi - lo + 1) / 2;
+          if(regionBytes(count, block_sizes_list[i]) <= targets[i]) {
+            lo = count;
+          } else {
+            hi = count - 1;
+          }
+        }
+        block_counts[i] = (pool_index_t)lo;
+        used_bytes += regionBytes(lo, block_sizes_list[i]);
+      }
+      return used_bytes <= available_bytes;
   }
-  // Went through the occupied map and found no open slot
   return false;
 }
 
 // Helpers
-void insertionSort(uint16_t arr[], const uint8_t n) {
+void insertionSort(pool_index_t arr[], const uint8_t n) {
   int16_t i, j;
-  uint16_t key;
+  pool_index_t key;
   for (i = 1; i < n; i++) {
     key = arr[i];
     j = i-1;
@@ -245,17 +3018,26 @@ void insertionSort(uint16_t arr[], const uint8_t n) {
 }
 
 void printMemory() {
+  assert(f_pool_init);
+  printMemory_h(g_default_pool);
+}
+
+void printMemory_h(pool_t* pool) {
+  pool_index_t* block_sizes_list = pool->block_sizes_list;
+  pool_index_t* block_offset_list = pool->block_offset_list;
+  uint8_t** block_base_addr = pool->block_base_addr;
+  size_t num_block_size = pool->num_block_size;
   printf("Region: BlockSize ----------------------------------------\n");
   printf("Start address: %p\n", block_sizes_list);
   for(size_t i = 0; i < num_block_size; i++) {
-    printf("Block: %d B\n", ((uint16_t*)block_sizes_list)[i]);
+    printf("Block: %u B\n", (unsigned)block_sizes_list[i]);
   }
   printf("\n");
 
   printf("Region: Offset -------------------------------------------\n");
   printf("Start address: %p\n", block_offset_list);
   for(size_t i = 0; i < num_block_size; i++) {
-    printf("Offset: %d B\n", ((uint16_t*)block_offset_list)[i]);
+    printf("Offset: %u B\n", (unsigned)block_offset_list[i]);
   }
   printf("\n");
 
@@ -266,36 +3048,150 @@ void printMemory() {
   }
   printf("\n");
 
-  for(uint16_t i = 0; i < num_block_size; i++) {
-    printf("Slice %d: %dB Slices =================================\n", i + 1, ((uint16_t*)block_sizes_list)[i]);
-
-    char occ_map_str[65536] = "";
-    uint16_t capacity = 0;
-    for(uint16_t j = 0; j < ((uint16_t*)block_offset_list)[i]; j++){
-      uint8_t occ_map_byte = *((uint8_t*)(block_base_addr[i]) + j);
-      if(occ_map_byte == 0){
-        strcat(occ_map_str, "00000000");
-        capacity += 8;
-      } else if (occ_map_byte == 255) {
-        strcat(occ_map_str, "11111111");
-      } else {
-        for (uint8_t k = 0; k < 8; k++) {
-          if((occ_map_byte & 0x1) == 1){
-            strcat(occ_map_str, "1");
-          } else {
-            strcat(occ_map_str, "0");
-            capacity += 1;
-          }
-          occ_map_byte = occ_map_byte >> 1;
-        }
+  pool_stats_h(pool, NULL, 0);   // Fold in this thread's cached counts
+  for(size_t i = 0; i < num_block_size; i++) {
+    printf("Slice %zu: %uB Slices =================================\n", i + 1, (unsigned)block_sizes_list[i]);
+
+    uint64_t* occ_map = (uint64_t*)block_base_addr[i];
+    pool_index_t om_words = mapWords(pool, i);
+    pool_region_stats_t stats;
+    readRegionStats(&pool->region_stats[i], &stats);
+    uint8_t* region_end = (i + 1 < num_block_size) ? slotBase(pool, i + 1) : pool->alloc_end_addr;
+    printf("Remaining capacity: %llu\n", (unsigned long long)(stats.capacity - stats.live));
+    printf("Alignment: %zu B, padding %zu B\n", stats.alignment, stats.padding);
+    printf("Live: %llu (high water %llu), allocs %llu, frees %llu, spills %llu, failures %llu\n",
+           (unsigned long long)stats.live, (unsigned long long)stats.high_water, (unsigned long long)stats.allocs,
+           (unsigned long long)stats.frees, (unsigned long long)stats.spills, (unsigned long long)stats.failures);
+    printf("Summary Map: %p\n", pool->block_summary_addr[i]);
+    printf("Alloc Start: %p\n", slotBase(pool, i));
+    printf("Alloc End: %p\n", region_end);
+    printf("Occ Map: ");
+    for(pool_index_t j = 0; j < om_words; j++){
+      for(uint8_t k = 0; k < OCC_WORD_BITS; k++) {
+        putchar(((occ_map[j] >> k) & 0x1) ? '1' : '0');
       }
     }
-    printf("Remaining capacity: %d\n", capacity);
-    printf("Alloc Start: %p\n", ((uint8_t**)block_base_addr)[i]);
-    printf("Alloc End: %p\n", ((uint8_t**)block_base_addr)[i] + ((uint16_t*)block_offset_list)[i]*sizeof(uint8_t) + capacity *((uint16_t*)block_sizes_list)[i]);
-    printf("Occ Map: %s\n", occ_map_str);
-    printf("\n");
+    printf("\n\n");
+  }
+
+  printf("Heap allocation end address: %p\n\n", pool->alloc_end_addr);
+}
+
+#ifdef POOL_ELASTIC
+/*
+ * Allocates a block of size class c of an elastic pool, from the slab that last had room, any other slab
+ * with room, or a new slab from the provider. Returns NULL once the provider runs out.
+ */
+static void* elasticClassAlloc(pool_elastic_t* pool, size_t c) {
+  elastic_class_t* cls = &pool->classes[c];
+  void* ptr = NULL;
+  ELASTIC_LOCK(cls);
+  pool_slab_t* slab = cls->hint;
+  if((slab == NULL) || (slab->live == slab->capacity)) {
+    slab = cls->slabs;
+    while((slab != NULL) && (slab->live == slab->capacity)) {
+      slab = slab->next;
+    }
+  }
+  if(slab == NULL) {
+    slab = elasticSlabAcquire(pool, cls, c);
+  }
+  // The slab pools are only reached under the class lock, and the bulk call bypasses the per-thread caches
+  if((slab != NULL) && (pool_malloc_bulk_h(slab->pool, cls->block_size, &ptr, 1) == 1)) {
+    if(slab->live++ == 0) {
+      cls->empty_slabs--;
+    }
+    cls->live++;
+    cls->hint = slab;
+  }
+  ELASTIC_UNLOCK(cls);
+  return ptr;
+}
+
+/*
+ * Adds an empty slab to the front of the chain of size class c. Returns NULL if the provider has no memory,
+ * or hands out memory that is not aligned to the slab length.
+ */
+static pool_slab_t* elasticSlabAcquire(pool_elastic_t* pool, elastic_class_t* cls, size_t c) {
+  uint8_t* mem = pool->provider.acquire(pool->slab_len, pool->provider.ctx);
+  if(mem == NULL) {
+    return NULL;
+  }
+  if(((uintptr_t)mem & (pool->slab_len - 1)) != 0) {
+#ifdef DEBUG
+    printf("[TMA] Slab %p is not aligned to %zu bytes!\n", (void*)mem, pool->slab_len);
+#endif
+    pool->provider.release(mem, pool->slab_len, pool->provider.ctx);
+    return NULL;
+  }
+  size_t block_size = cls->block_size;
+  pool_t* slab_pool = pool_create(mem + SLAB_HEADER_LEN, pool->slab_len - SLAB_HEADER_LEN, &block_size, 1);
+  if(slab_pool == NULL) {
+    pool->provider.release(mem, pool->slab_len, pool->provider.ctx);
+    return NULL;
+  }
+
+  pool_slab_t* slab = (pool_slab_t*)mem;
+  *slab = (pool_slab_t){
+    .owner = pool,
+    .next = cls->slabs,
+    .pool = slab_pool,
+    .capacity = slab_pool->region_stats[0].capacity,
+    .class_idx = (uint8_t)c,
+  };
+  cls->slabs = slab;
+  cls->num_slabs++;
+  cls->empty_slabs++;
+  cls->capacity += slab->capacity;
+  cls->acquires++;
+  return slab;
+}
+
+/*
+ * Unlinks a slab from the chain of its size class and hands it back to the provider.
+ */
+static void elasticSlabRelease(pool_elastic_t* pool, elastic_class_t* cls, pool_slab_t* slab) {
+  pool_slab_t** link = &cls->slabs;
+  while(*link != slab) {
+    link = &(*link)->next;
+  }
+  *link = slab->next;
+  if(cls->hint == slab) {
+    cls->hint = cls->slabs;
+  }
+  cls->num_slabs--;
+  cls->capacity -= slab->capacity;
+  cls->live -= slab->live;
+  if(slab->live == 0) {
+    cls->empty_slabs--;
+  }
+  cls->releases++;
+  slab->owner = NULL;
+  pool->provider.release(slab, pool->slab_len, pool->provider.ctx);
+}
+
+/*
+ * Default slab provider: maps twice the slab length and trims it down to one aligned slab.
+ */
+static void* mapSlab(size_t len, void* ctx) {
+  (void)ctx;
+  size_t map_len = 2 * len;
+  uint8_t* raw = pool_map(&map_len, POOL_MAP_DEFAULT, POOL_NUMA_ANY, NULL);
+  if(raw == NULL) {
+    return NULL;
   }
+  uint8_t* mem = (uint8_t*)(((uintptr_t)raw + len - 1) & ~(uintptr_t)(len - 1));
+  if(mem > raw) {
+    pool_unmap(raw, mem - raw);
+  }
+  if(raw + map_len > mem + len) {
+    pool_unmap(mem + len, raw + map_len - (mem + len));
+  }
+  return mem;
+}
 
-  printf("Heap allocation end address: %p\n\n", alloc_end_addr);
+static void unmapSlab(void* mem, size_t len, void* ctx) {
+  (void)ctx;
+  pool_unmap(mem, len);
 }
+#endif
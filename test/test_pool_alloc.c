@@ -1,11 +1,45 @@
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
 #include <check.h>
 
 #include "include/pool_alloc.h"
 
+// Slots per region of the default pool, which every layout comment below refers to; update them whenever the
+// metadata in front of the regions changes. Large pools spend less of it on the region lookup, and slot splitting
+// builds spend some on the split table
+#if defined(POOL_LARGE) && defined(POOL_SPLIT)
+#define SLOTS_32_OF_32_64 670   // block_sizes = {32, 64}
+#define SLOTS_64_OF_32_64 669
+#define SLOTS_16_32 2671        // block_sizes = {16, 32}, both regions
+#elif defined(POOL_LARGE)
+#define SLOTS_32_OF_32_64 674
+#define SLOTS_64_OF_32_64 672
+#define SLOTS_16_32 2685
+#elif defined(POOL_SPLIT)
+#define SLOTS_32_OF_32_64 669
+#define SLOTS_64_OF_32_64 667
+#define SLOTS_16_32 2664
+#else
+#define SLOTS_32_OF_32_64 671
+#define SLOTS_64_OF_32_64 671
+#define SLOTS_16_32 2678
+#endif
+
+#ifdef POOL_THREAD_SAFE
+#include <pthread.h>
+
+#define STRESS_THREADS 8
+#define STRESS_ROUNDS 2000
+#define STRESS_BATCH 64
+#endif
+
 // START Test Suite: Normal memory initialization
 /*
  * Test: pool_init_unsorted
@@ -40,6 +74,74 @@ START_TEST (pool_init_sorted)
 END_TEST
 // END Test Suite: Normal memory initialization
 
+// START Test Suite: Workload-sized regions
+/*
+ * Test: sized_by_count
+ * Description: Regions hold exactly the requested number of blocks
+ * Precondition: block_sizes = {64, 32}, class_targets = {100, 1000} blocks
+ * Postcondition: Capacities match the targets; the 1001st 20B request spills into the 64B region, which then holds 99 more
+ */
+START_TEST (sized_by_count)
+{
+  size_t sizes_list[2] = {64, 32};
+  size_t targets[2] = {100, 1000};
+  size_t capacities[2] = {0, 0};
+
+  bool result = pool_init_sized(sizes_list, targets, 2, POOL_SIZE_BY_COUNT, capacities);
+  ck_assert(result);
+  ck_assert_uint_eq(capacities[0], 100);
+  ck_assert_uint_eq(capacities[1], 1000);
+  for(size_t i = 0; i < 1001; i++){
+    ck_assert_ptr_ne(pool_malloc(20), NULL);
+  }
+  for(size_t i = 0; i < 99; i++){
+    ck_assert_ptr_ne(pool_malloc(40), NULL);
+  }
+  ck_assert_ptr_eq(pool_malloc(40), NULL);
+}
+END_TEST
+
+/*
+ * Test: sized_by_weight
+ * Description: Block counts follow the weights and use up the heap
+ * Precondition: block_sizes = {512, 32}, class_targets = {1, 3}
+ * Postcondition: The 32B region holds about three times as many blocks as the 512B region; less than one 512B block's worth of heap is left
+ */
+START_TEST (sized_by_weight)
+{
+  size_t sizes_list[2] = {512, 32};
+  size_t targets[2] = {1, 3};
+  size_t capacities[2] = {0, 0};
+
+  bool result = pool_init_sized(sizes_list, targets, 2, POOL_SIZE_BY_WEIGHT, capacities);
+  ck_assert(result);
+  // Bytes too few for another 512B block may still go to the 32B region
+  ck_assert_uint_le(capacities[1], 3 * capacities[0] + 512 / 32 + 3);
+  ck_assert_uint_ge(capacities[1] + 3, 3 * capacities[0]);
+  ck_assert_uint_gt(capacities[0] * 512 + capacities[1] * 32, MAX_HEAP_SIZE - 2048);
+}
+END_TEST
+
+/*
+ * Test: sized_by_bytes
+ * Description: Each region fits its byte budget, occupation and summary maps included
+ * Precondition: block_sizes = {32, 64}, class_targets = {8192, 8192} bytes
+ * Postcondition: 254 blocks of 32B (8128 + 32 + 8 bytes) and 127 blocks of 64B (8128 + 16 + 8 bytes)
+ */
+START_TEST (sized_by_bytes)
+{
+  size_t sizes_list[2] = {32, 64};
+  size_t targets[2] = {8192, 8192};
+  size_t capacities[2] = {0, 0};
+
+  bool result = pool_init_sized(sizes_list, targets, 2, POOL_SIZE_BY_BYTES, capacities);
+  ck_assert(result);
+  ck_assert_uint_eq(capacities[0], 254);
+  ck_assert_uint_eq(capacities[1], 127);
+}
+END_TEST
+// END Test Suite: Workload-sized regions
+
 // START Test Suite: Bad initialization parameters
 /*
  * Test: list_too_long
@@ -122,6 +224,25 @@ START_TEST (total_too_large)
   ck_assert(!result);
 }
 END_TEST
+
+/*
+ * Test: sized_too_large
+ * Description: Region targets that cannot fit the heap, or a zero target
+ * Precondition: block_sizes = {32, 64}, class_targets = {2100, 1} blocks, then {0, 1} weights
+ * Postcondition: False (Failed allocation)
+ */
+START_TEST (sized_too_large)
+{
+  size_t sizes_list[2] = {32, 64};
+  size_t counts[2] = {2100, 1};
+  size_t weights[2] = {0, 1};
+  static uint64_t buf[MAX_HEAP_SIZE / sizeof(uint64_t)];
+
+  ck_assert_ptr_eq(pool_create_sized(buf, sizeof(buf), sizes_list, weights, 2, POOL_SIZE_BY_WEIGHT, NULL), NULL);
+  bool result = pool_init_sized(sizes_list, counts, 2, POOL_SIZE_BY_COUNT, NULL);
+  ck_assert(!result);
+}
+END_TEST
 // END Test Suite: Tricky memory block list combinations
 
 Suite * pool_init_suite(void)
@@ -133,6 +254,12 @@ Suite * pool_init_suite(void)
   tcase_add_test(tc_normal_init, pool_init_sorted);
   suite_add_tcase(s, tc_normal_init);
 
+  TCase* tc_sized_init = tcase_create("Workload-sized regions");
+  tcase_add_test(tc_sized_init, sized_by_count);
+  tcase_add_test(tc_sized_init, sized_by_weight);
+  tcase_add_test(tc_sized_init, sized_by_bytes);
+  suite_add_tcase(s, tc_sized_init);
+
   TCase* tc_bad_init_params = tcase_create("Bad initialization parameters");
   tcase_add_test(tc_bad_init_params, list_too_long);
   tcase_add_test(tc_bad_init_params, list_size_zero);
@@ -142,6 +269,7 @@ Suite * pool_init_suite(void)
 
   TCase* tc_tricky_combinations = tcase_create("Tricky memory block list combinations");
   tcase_add_test(tc_tricky_combinations, total_too_large);
+  tcase_add_test(tc_tricky_combinations, sized_too_large);
   suite_add_tcase(s, tc_tricky_combinations);
 
   return s;
@@ -164,13 +292,13 @@ START_TEST (single_alloc)
   uint8_t* result_ptr = (uint8_t*) pool_malloc(20);
 
   // With MAX_HEAP_SIZE = 65536, we should get
-  // 681 slices (9 bytes) - 32B
-  // 680 slices (8 bytes) - 64B
-  void* base_addr_32 = result_ptr - 86;
+  // SLOTS_32_OF_32_64 slices (11 words) - 32B
+  // SLOTS_64_OF_32_64 slices (11 words) - 64B
+  void* base_addr_32 = result_ptr - 88;
   void* addr_list = base_addr_32 - num_elements * sizeof(uint8_t*);
-  void* offset_addr = addr_list - 4;
+  void* offset_addr = addr_list - num_elements * sizeof(pool_index_t);
   ck_assert_ptr_eq(*((uint8_t**)addr_list), base_addr_32);
-  ck_assert_uint_eq(*((uint16_t*)offset_addr), 86);
+  ck_assert_uint_eq(*((pool_index_t*)offset_addr), 88);
 }
 END_TEST
 
@@ -191,28 +319,28 @@ START_TEST (multi_size_alloc)
   void* ptr_40 = (uint8_t*) pool_malloc(40);
 
   // With MAX_HEAP_SIZE = 65536, we should get
-  // 681 slices (9 bytes) - 32B
-  // 680 slices (8 bytes) - 64B
+  // SLOTS_32_OF_32_64 slices (11 words) - 32B
+  // SLOTS_64_OF_32_64 slices (11 words) - 64B
 
   // Ensure ptr_20 is allocated correctly
-  void* base_addr_32 = ptr_20 - 86;
+  void* base_addr_32 = ptr_20 - 88;
   void* addr_list = base_addr_32 - num_elements * sizeof(uint8_t*);
-  void* offset_addr = addr_list - 4;
+  void* offset_addr = addr_list - num_elements * sizeof(pool_index_t);
   ck_assert_ptr_eq(*((uint8_t**)addr_list), base_addr_32);
-  ck_assert_uint_eq(*((uint16_t*)offset_addr), 86);
+  ck_assert_uint_eq(*((pool_index_t*)offset_addr), 88);
 
   // Ensure ptr_40 is allocated correctly
   void* base_addr_64 = ((uint8_t**)addr_list)[1];
-  uint16_t offset_64 = *((uint16_t*)(offset_addr + sizeof(uint16_t)));
-  ck_assert_uint_eq(offset_64, 85);
+  pool_index_t offset_64 = *((pool_index_t*)(offset_addr + sizeof(pool_index_t)));
+  ck_assert_uint_eq(offset_64, 88);
   ck_assert_ptr_eq(base_addr_64 + offset_64, ptr_40);
 }
 END_TEST
 
 /*
  * Test: fill_block_alloc
- * Description: Continuously request 20 for 682 units and verify the 682nd unit is in the 64B block region
- * Precondition: block_sizes = {32, 64}, request size 20 for 682 times
+ * Description: Continuously request 20 for SLOTS_32_OF_32_64 + 1 units and verify the last one is in the 64B block region
+ * Precondition: block_sizes = {32, 64}, request size 20 for SLOTS_32_OF_32_64 + 1 times
  * Postcondition: A pointer with the correct relative location
  */
 START_TEST (fill_block_alloc)
@@ -223,32 +351,64 @@ START_TEST (fill_block_alloc)
   bool result = pool_init(sizes_list, num_elements);
   ck_assert(result);
   void* ptr_in_32 = pool_malloc(20); // Used to easily calculate offsets
-  for(size_t i = 1; i < 681; i++){
+  for(size_t i = 1; i < SLOTS_32_OF_32_64; i++){
     pool_malloc(20);
   }
   void* result_ptr = pool_malloc(20);
   // Calculate where the base address of the 64 B region is and compare
   // With MAX_HEAP_SIZE = 65536, we should get
-  // 681 slices (9 bytes) - 32B
-  // 680 slices (8 bytes) - 64B
+  // SLOTS_32_OF_32_64 slices (11 words) - 32B
+  // SLOTS_64_OF_32_64 slices (11 words) - 64B
 
   // Ensure ptr_20 is allocated correctly
-  void* base_addr_32 = ptr_in_32 - 86;
+  void* base_addr_32 = ptr_in_32 - 88;
   void* addr_list = base_addr_32 - num_elements * sizeof(uint8_t*);
-  void* offset_addr = addr_list - 4;
+  void* offset_addr = addr_list - num_elements * sizeof(pool_index_t);
 
   // Ensure ptr_40 is allocated correctly
   void* base_addr_64 = ((uint8_t**)addr_list)[1];
-  uint16_t offset_64 = *((uint16_t*)(offset_addr + sizeof(uint16_t)));
-  ck_assert_uint_eq(offset_64, 85);
+  pool_index_t offset_64 = *((pool_index_t*)(offset_addr + sizeof(pool_index_t)));
+  ck_assert_uint_eq(offset_64, 88);
   ck_assert_ptr_eq(base_addr_64 + offset_64, result_ptr);
 }
 END_TEST
 
+/*
+ * Test: size_class_lookup
+ * Description: Requests on either side of each block size land in the smallest block that fits, for both small and large sizes
+ * Precondition: block_sizes = {7, 300, 1000, 5000}, request pairs that share a block size
+ * Postcondition: Each pair of pointers is exactly one block apart
+ */
+START_TEST (size_class_lookup)
+{
+  size_t sizes_list[4] = {5000, 7, 1000, 300};
+  size_t num_elements = 4;
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+
+  uint8_t* ptr_1 = pool_malloc(1);
+  uint8_t* ptr_7 = pool_malloc(7);
+  ck_assert_ptr_eq(ptr_1 + 7, ptr_7);
+
+  uint8_t* ptr_8 = pool_malloc(8);
+  uint8_t* ptr_300 = pool_malloc(300);
+  ck_assert_ptr_eq(ptr_8 + 300, ptr_300);
+
+  uint8_t* ptr_301 = pool_malloc(301);
+  uint8_t* ptr_1000 = pool_malloc(1000);
+  ck_assert_ptr_eq(ptr_301 + 1000, ptr_1000);
+
+  uint8_t* ptr_1001 = pool_malloc(1001);
+  uint8_t* ptr_5000 = pool_malloc(5000);
+  ck_assert_ptr_eq(ptr_1001 + 5000, ptr_5000);
+}
+END_TEST
+
 /*
  * Test: no_space_left
  * Description: Check attempt to malloc with no space left
- * Precondition: block_sizes = {32, 64}, request size 40, 681 times
+ * Precondition: block_sizes = {32, 64}, request size 40, SLOTS_64_OF_32_64 + 1 times
  * Postcondition: NULL pointer returned
  */
 START_TEST (no_space_left)
@@ -258,7 +418,7 @@ START_TEST (no_space_left)
 
   bool result = pool_init(sizes_list, num_elements);
   ck_assert(result);
-  for(size_t i = 0; i < 680; i++){
+  for(size_t i = 0; i < SLOTS_64_OF_32_64; i++){
     pool_malloc(40);
   }
   void* result_ptr = pool_malloc(40);
@@ -303,6 +463,389 @@ START_TEST (too_large)
   ck_assert_ptr_eq(result_ptr, NULL);
 }
 END_TEST
+
+/*
+ * Test: bulk_alloc
+ * Description: Allocate a batch that fills the 32B region and spills into the 64B region
+ * Precondition: block_sizes = {32, 64}, SLOTS_32_OF_32_64 + 10 requests of 20B in one call
+ * Postcondition: Every slot of the 32B region in order, then the first 10 slots of the 64B region
+ */
+START_TEST (bulk_alloc)
+{
+  size_t sizes_list[2] = {32, 64};
+  void* ptrs[SLOTS_32_OF_32_64 + 10];
+
+  ck_assert(pool_init(sizes_list, 2));
+  ck_assert_uint_eq(pool_malloc_bulk(20, ptrs, SLOTS_32_OF_32_64 + 10), SLOTS_32_OF_32_64 + 10);
+  for(size_t i = 1; i < SLOTS_32_OF_32_64; i++){
+    ck_assert_ptr_eq(ptrs[i], (uint8_t*)ptrs[0] + 32 * i);
+  }
+  for(size_t i = SLOTS_32_OF_32_64 + 1; i < SLOTS_32_OF_32_64 + 10; i++){
+    ck_assert_ptr_eq(ptrs[i], (uint8_t*)ptrs[SLOTS_32_OF_32_64] + 64 * (i - SLOTS_32_OF_32_64));
+  }
+  ck_assert_uint_eq(pool_malloc_bulk(40, ptrs, SLOTS_64_OF_32_64), SLOTS_64_OF_32_64 - 10);
+  ck_assert_uint_eq(pool_malloc_bulk(0, ptrs, 4), 0);
+}
+END_TEST
+
+/*
+ * Test: region_stats
+ * Description: Per-region counters follow allocations, frees, spills and failures
+ * Precondition: block_sizes = {32, 64}, SLOTS_32_OF_32_64 + 3 requests of 20B, two of them freed, then a bulk request of 40B
+ *               for every 64B slot
+ * Postcondition: 3 spills counted against the 32B region; the 64B region full, with the 3 blocks the bulk request missed as failures
+ */
+START_TEST (region_stats)
+{
+  size_t sizes_list[2] = {32, 64};
+  void* ptrs[SLOTS_64_OF_32_64];
+  pool_region_stats_t stats[2];
+
+  ck_assert(pool_init(sizes_list, 2));
+  for(size_t i = 0; i < SLOTS_32_OF_32_64 + 3; i++){
+    void* ptr = pool_malloc(20);
+    ck_assert_ptr_ne(ptr, NULL);
+    if(i < 2){
+      ptrs[i] = ptr;
+    }
+  }
+  pool_free(ptrs[0]);
+  pool_free(ptrs[1]);
+  ck_assert_uint_eq(pool_malloc_bulk(40, ptrs, SLOTS_64_OF_32_64), SLOTS_64_OF_32_64 - 3);
+  ck_assert_ptr_eq(pool_malloc(100), NULL);
+
+  ck_assert_uint_eq(pool_stats(stats, 2), 2);
+  ck_assert_uint_eq(stats[0].block_size, 32);
+  ck_assert_uint_eq(stats[0].capacity, SLOTS_32_OF_32_64);
+  ck_assert_uint_eq(stats[0].live, SLOTS_32_OF_32_64 - 2);
+  ck_assert_uint_eq(stats[0].high_water, SLOTS_32_OF_32_64);
+  ck_assert_uint_eq(stats[0].allocs, SLOTS_32_OF_32_64);
+  ck_assert_uint_eq(stats[0].frees, 2);
+  ck_assert_uint_eq(stats[0].spills, 3);
+  ck_assert_uint_eq(stats[0].failures, 0);
+  ck_assert_uint_eq(stats[1].block_size, 64);
+  ck_assert_uint_eq(stats[1].capacity, SLOTS_64_OF_32_64);
+  ck_assert_uint_eq(stats[1].live, SLOTS_64_OF_32_64);
+  ck_assert_uint_eq(stats[1].high_water, SLOTS_64_OF_32_64);
+  ck_assert_uint_eq(stats[1].allocs, SLOTS_64_OF_32_64);
+  ck_assert_uint_eq(stats[1].frees, 0);
+  ck_assert_uint_eq(stats[1].spills, 0);
+  ck_assert_uint_eq(stats[1].failures, 3);
+
+  // Only the regions that fit are written
+  stats[1].block_size = 0;
+  ck_assert_uint_eq(pool_stats(stats, 1), 2);
+  ck_assert_uint_eq(stats[1].block_size, 0);
+}
+END_TEST
+
+/*
+ * Test: locality_placement
+ * Description: pool_malloc_near takes the free slot nearest its hint; next-fit keeps claiming past the last claim instead of
+ *              going back to slots freed lower down
+ * Precondition: block_sizes = {32, 64}, the first 128 slots of the 32B region allocated with slots 10 and 100 freed, then
+ *               after a reset and a switch to next-fit, 130 slots allocated and slot 3 freed
+ * Postcondition: Hints in words 1 and 0 get slots 100 and 10, a hint in two full words gets slot 128; next-fit takes slot 130
+ *                over slot 3 until first-fit is restored
+ */
+START_TEST (locality_placement)
+{
+  size_t sizes_list[2] = {32, 64};
+  uint8_t* ptrs[130];
+
+  ck_assert(pool_init(sizes_list, 2));
+  ck_assert_uint_eq(pool_malloc_bulk(20, (void**)ptrs, 128), 128);
+  pool_free_bulk((void**)&ptrs[10], 1);
+  pool_free_bulk((void**)&ptrs[100], 1);
+  ck_assert_ptr_eq(pool_malloc_near(20, ptrs[99] + 5), ptrs[100]);
+  ck_assert_ptr_eq(pool_malloc_near(20, ptrs[0]), ptrs[10]);
+  ck_assert_ptr_eq(pool_malloc_near(20, ptrs[0]), ptrs[0] + 32 * 128);
+  // Hints in another size class, or outside the pool, fall back to the regular search
+  uint8_t* other = pool_malloc_near(20, pool_malloc(40));
+  ck_assert_uint_eq(pool_usable_size(other), 32);
+  ck_assert_uint_eq(pool_usable_size(pool_malloc_near(20, &other)), 32);
+  ck_assert_ptr_eq(pool_malloc_near(0, ptrs[0]), NULL);
+
+  pool_reset();
+  ck_assert(!pool_set_placement((pool_placement_t)2));
+  ck_assert(pool_set_placement(POOL_PLACE_NEXT_FIT));
+  ck_assert_uint_eq(pool_malloc_bulk(20, (void**)ptrs, 130), 130);
+  pool_free_bulk((void**)&ptrs[3], 1);
+  uint8_t* next;
+  ck_assert_uint_eq(pool_malloc_bulk(20, (void**)&next, 1), 1);
+  ck_assert_ptr_eq(next, ptrs[0] + 32 * 130);
+  ck_assert(pool_set_placement(POOL_PLACE_FIRST_FIT));
+  ck_assert_uint_eq(pool_malloc_bulk(20, (void**)&next, 1), 1);
+  ck_assert_ptr_eq(next, ptrs[3]);
+}
+END_TEST
+
+#ifdef POOL_SPLIT
+/*
+ * Test: slot_splitting
+ * Description: With the 16B region full, 10B requests take 16B sub-slots of split 64B slots instead of whole ones; a split slot
+ *              goes back to its region once its last sub-slot is freed
+ * Precondition: block_sizes = {16, 64} with 4 blocks each in a pool_create pool, the 16B region filled, splitting enabled
+ * Postcondition: Five requests split two 64B slots and spill nothing; a reused sub-slot is traced with its 64B slot; after freeing
+ *                and moving the first slot's sub-slots it merges, and with splitting off a request spills into a whole slot again
+ */
+START_TEST (slot_splitting)
+{
+  static uint8_t mem[4096];
+  size_t sizes_list[2] = {16, 64};
+  size_t counts[2] = {4, 4};
+  void* small[4];
+  pool_region_stats_t stats[2];
+  pool_split_stats_t split_stats;
+
+  pool_t* pool = pool_create_sized(mem, sizeof(mem), sizes_list, counts, 2, POOL_SIZE_BY_COUNT, NULL);
+  ck_assert_ptr_ne(pool, NULL);
+  for(size_t i = 0; i < 4; i++){
+    small[i] = pool_malloc_h(pool, 10);
+  }
+  ck_assert(pool_set_splitting_h(pool, true));
+  uint8_t* sub[5];
+  ck_assert_ptr_ne(small[3], NULL);
+  for(size_t i = 0; i < 5; i++){
+    sub[i] = pool_malloc_h(pool, 10);
+    ck_assert_uint_eq(pool_usable_size_h(pool, sub[i]), 16);
+  }
+  for(size_t i = 1; i < 4; i++){
+    ck_assert_ptr_eq(sub[i], sub[0] + 16 * i);
+  }
+  ck_assert_ptr_eq(sub[4], sub[0] + 64);
+  ck_assert_uint_eq(pool_usable_size_h(pool, sub[0] + 8), 0);
+  pool_stats_h(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].spills, 0);
+  ck_assert_uint_eq(stats[1].live, 2);
+  pool_split_stats_h(pool, &split_stats);
+  ck_assert_uint_eq(split_stats.splits, 2);
+  ck_assert_uint_eq(split_stats.borrows, 5);
+  ck_assert_uint_eq(split_stats.split_slots, 2);
+  ck_assert_uint_eq(split_stats.sub_slots, 8);
+  ck_assert_uint_eq(split_stats.sub_live, 5);
+  ck_assert_uint_eq(split_stats.idle_bytes, 3 * 16);
+
+  // A freed sub-slot is reused before anything else is split
+#ifdef POOL_TRACE
+  pool_trace_event_t events[2];
+  pool_trace_reset();
+#endif
+  pool_free_h(pool, sub[1]);
+  ck_assert_ptr_eq(pool_malloc_h(pool, 10), sub[1]);
+#ifdef POOL_TRACE
+  // Both events of a sub-slot name the 64B slot it was split from
+  ck_assert_uint_eq(pool_trace_read(events, 2), 2);
+  ck_assert_uint_eq(events[0].op, POOL_TRACE_FREE);
+  ck_assert_uint_eq(events[1].op, POOL_TRACE_MALLOC);
+  ck_assert_uint_eq(events[0].region, 1);
+  ck_assert_uint_eq(events[1].region, 1);
+  ck_assert_uint_eq(events[1].slot, events[0].slot);
+#endif
+  // Growing moves the sub-slot into a whole slot; the split slot merges once its last sub-slot is gone
+  uint8_t* grown = pool_realloc_h(pool, sub[2], 40);
+  ck_assert_uint_eq(pool_usable_size_h(pool, grown), 64);
+  void* rest[3] = {sub[0], sub[1], sub[3]};
+  pool_free_bulk_h(pool, rest, 3);
+  pool_split_stats_h(pool, &split_stats);
+  ck_assert_uint_eq(split_stats.merges, 1);
+  ck_assert_uint_eq(split_stats.split_slots, 1);
+  ck_assert_uint_eq(split_stats.sub_live, 1);
+
+  ck_assert(pool_set_splitting_h(pool, false));
+  uint8_t* spilled = pool_malloc_h(pool, 10);
+  ck_assert_uint_eq(pool_usable_size_h(pool, spilled), 64);
+  pool_stats_h(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].spills, 1);
+  ck_assert_uint_eq(stats[1].live, 3);
+  // Resetting the region drops the slot still split along with its sub-slots
+  ck_assert(pool_reset_region_h(pool, 1));
+  pool_split_stats_h(pool, &split_stats);
+  ck_assert_uint_eq(split_stats.split_slots, 0);
+}
+END_TEST
+#endif
+
+#ifdef POOL_HISTOGRAM
+/*
+ * Test: size_histogram
+ * Description: Requested sizes are recorded per bucket, including requests that fail
+ * Precondition: block_sizes = {32, 64}, requests 20 x3, 40 x1 and 2000 x2
+ * Postcondition: Buckets {20: 3}, {40: 1}, {2048: 2}; no buckets after a reset
+ */
+START_TEST (size_histogram)
+{
+  size_t sizes_list[2] = {32, 64};
+  pool_histogram_entry_t entries[4];
+
+  ck_assert(pool_init(sizes_list, 2));
+  for(size_t i = 0; i < 3; i++){
+    pool_malloc(20);
+  }
+  pool_malloc(40);
+  pool_malloc(2000);
+  pool_malloc(2000);
+
+  ck_assert_uint_eq(pool_histogram(entries, 4), 3);
+  ck_assert_uint_eq(entries[0].size, 20);
+  ck_assert_uint_eq(entries[0].count, 3);
+  ck_assert_uint_eq(entries[1].size, 40);
+  ck_assert_uint_eq(entries[1].count, 1);
+  ck_assert_uint_eq(entries[2].size, 2048);
+  ck_assert_uint_eq(entries[2].count, 2);
+
+  pool_histogram_reset();
+  ck_assert_uint_eq(pool_histogram(entries, 4), 0);
+}
+END_TEST
+#endif
+
+#ifdef POOL_TRACE
+/*
+ * Test: trace_events
+ * Description: Allocations and frees are traced in order with their region, slot and size, and dumped to a file
+ * Precondition: block_sizes = {32, 64}, requests of 20 and 40 bytes, then the 20B block freed
+ * Postcondition: Three events in order, matching the pointers; the dump holds the same three events; none after a reset
+ */
+START_TEST (trace_events)
+{
+  size_t sizes_list[2] = {32, 64};
+  pool_trace_event_t events[4];
+  char path[] = "/tmp/tbp_trace_XXXXXX";
+
+  ck_assert(pool_init(sizes_list, 2));
+  pool_trace_reset();
+  void* small = pool_malloc(20);
+  void* large = pool_malloc(40);
+  pool_free(small);
+
+  ck_assert_uint_eq(pool_trace_read(events, 4), 3);
+  ck_assert_uint_eq(events[0].op, POOL_TRACE_MALLOC);
+  ck_assert_uint_eq(events[0].ptr, (uintptr_t)small);
+  ck_assert_uint_eq(events[0].size, 20);
+  ck_assert_uint_eq(events[0].region, 0);
+  ck_assert_uint_eq(events[1].ptr, (uintptr_t)large);
+  ck_assert_uint_eq(events[1].region, 1);
+  ck_assert_uint_eq(events[2].op, POOL_TRACE_FREE);
+  ck_assert_uint_eq(events[2].ptr, (uintptr_t)small);
+  ck_assert_uint_eq(events[2].slot, events[0].slot);
+  ck_assert_uint_ge(events[2].timestamp, events[0].timestamp);
+
+  int fd = mkstemp(path);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+  ck_assert(pool_trace_dump(path));
+  FILE* in = fopen(path, "rb");
+  pool_trace_header_t header;
+  ck_assert_uint_eq(fread(&header, sizeof(header), 1, in), 1);
+  ck_assert_uint_eq(header.magic, POOL_TRACE_MAGIC);
+  ck_assert_uint_eq(header.num_events, 3);
+  ck_assert_uint_eq(fread(events, sizeof(pool_trace_event_t), 4, in), 3);
+  ck_assert_uint_eq(events[1].ptr, (uintptr_t)large);
+  fclose(in);
+  unlink(path);
+
+  pool_trace_reset();
+  ck_assert_uint_eq(pool_trace_read(events, 4), 0);
+}
+END_TEST
+
+/*
+ * Runs tools/pool_replay over a trace file in one window and reads its failure, spill and live counts
+ */
+static void replayTrace(const char* path, const char* pool_args, size_t* failures, size_t* traced_failures, size_t* live, uint64_t* spills)
+{
+  char command[512];
+  char line[256];
+  snprintf(command, sizeof(command), "%s -w 1 %s %s", POOL_REPLAY, path, pool_args);
+  FILE* out = popen(command, "r");
+  ck_assert_ptr_ne(out, NULL);
+
+  size_t rows = 0;
+  size_t unmatched_frees = 1;
+  *spills = 0;
+  while(fgets(line, sizeof(line), out) != NULL){
+    unsigned long long window[9];
+    unsigned long long region[5];
+    size_t summary[4];
+    if(sscanf(line, "%llu %llu %llu %llu %llu %llu %llu %llu.%*u %llu", &window[0], &window[1], &window[2], &window[3], &window[4],
+              &window[5], &window[6], &window[7], &window[8]) == 9){
+      *live = (size_t)window[4];
+      rows++;
+    } else if(sscanf(line, "%zu failed allocations against %zu in the trace; %zu frees of blocks the replay does not hold; %zu events",
+                     &summary[0], &summary[1], &summary[2], &summary[3]) == 4){
+      *failures = summary[0];
+      *traced_failures = summary[1];
+      unmatched_frees = summary[2];
+      ck_assert_uint_eq(summary[3], 0);
+    } else if(sscanf(line, "%llu %llu %llu %llu %llu", &region[0], &region[1], &region[2], &region[3], &region[4]) == 5){
+      *spills += region[3];
+    }
+  }
+  ck_assert_int_eq(pclose(out), 0);
+  ck_assert_uint_eq(rows, 1);
+  ck_assert_uint_eq(unmatched_frees, 0);
+}
+
+/*
+ * Test: trace_replay
+ * Description: pool_replay replays a dumped trace against a block_sizes configuration and reports its failures, spills and live blocks
+ * Precondition: a 2048-byte {32, 64} pool; 20B requests until two spill into the 64B region, 40B requests until one fails, then
+ *               the first block freed; the trace replayed on the same configuration and on an 8192-byte one
+ * Postcondition: The same configuration fails and spills as the traced pool did; the larger one neither fails nor spills. Both end
+ *                with the traced live blocks
+ */
+START_TEST (trace_replay)
+{
+  size_t sizes_list[2] = {32, 64};
+  pool_region_stats_t stats[2];
+  char path[] = "/tmp/tbp_trace_XXXXXX";
+  // Memory from malloc, as pool_replay builds its pool in, so that both get the same capacities
+  void* mem = malloc(2048);
+  pool_t* pool = pool_create(mem, 2048, sizes_list, 2);
+  ck_assert_ptr_ne(pool, NULL);
+  ck_assert_uint_eq(pool_stats_h(pool, stats, 2), 2);
+
+  pool_trace_reset();
+  void* first = pool_malloc_h(pool, 20);
+  size_t traced_live = 1;
+  for(size_t i = 1; i < stats[0].capacity + 2; i++){
+    ck_assert_ptr_ne(pool_malloc_h(pool, 20), NULL);
+    traced_live++;
+  }
+  while(pool_malloc_h(pool, 40) != NULL){
+    traced_live++;
+  }
+  pool_free_h(pool, first);
+  traced_live--;
+  ck_assert_uint_eq(traced_live, stats[0].capacity + stats[1].capacity - 1);
+
+  int fd = mkstemp(path);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+  ck_assert(pool_trace_dump(path));
+  pool_destroy_h(pool);
+  free(mem);
+
+  size_t failures;
+  size_t traced_failures;
+  size_t live;
+  uint64_t spills;
+  replayTrace(path, "2048 32 64", &failures, &traced_failures, &live, &spills);
+  ck_assert_uint_eq(failures, 1);
+  ck_assert_uint_eq(traced_failures, 1);
+  ck_assert_uint_eq(spills, 2);
+  ck_assert_uint_eq(live, traced_live);
+
+  replayTrace(path, "8192 32 64", &failures, &traced_failures, &live, &spills);
+  ck_assert_uint_eq(failures, 0);
+  ck_assert_uint_eq(traced_failures, 1);
+  ck_assert_uint_eq(spills, 0);
+  ck_assert_uint_eq(live, traced_live);
+  unlink(path);
+}
+END_TEST
+#endif
 // END Test Suite: pool_malloc_suite
 
 Suite * pool_malloc_suite(void)
@@ -313,13 +856,42 @@ Suite * pool_malloc_suite(void)
   tcase_add_test(tc_normal_malloc, single_alloc);
   tcase_add_test(tc_normal_malloc, multi_size_alloc);
   tcase_add_test(tc_normal_malloc, fill_block_alloc);
+  tcase_add_test(tc_normal_malloc, size_class_lookup);
   tcase_add_test(tc_normal_malloc, no_space_left);
+  tcase_add_test(tc_normal_malloc, bulk_alloc);
   suite_add_tcase(s, tc_normal_malloc);
 
   TCase* tc_invalid_req = tcase_create("Invalid request size");
   tcase_add_test(tc_invalid_req, zero_size);
   tcase_add_test(tc_invalid_req, too_large);
   suite_add_tcase(s, tc_invalid_req);
+
+  TCase* tc_stats = tcase_create("Region statistics");
+  tcase_add_test(tc_stats, region_stats);
+  suite_add_tcase(s, tc_stats);
+
+  TCase* tc_placement = tcase_create("Locality hints and placement");
+  tcase_add_test(tc_placement, locality_placement);
+  suite_add_tcase(s, tc_placement);
+
+#ifdef POOL_SPLIT
+  TCase* tc_split = tcase_create("Slot splitting");
+  tcase_add_test(tc_split, slot_splitting);
+  suite_add_tcase(s, tc_split);
+#endif
+
+#ifdef POOL_HISTOGRAM
+  TCase* tc_histogram = tcase_create("Requested-size histogram");
+  tcase_add_test(tc_histogram, size_histogram);
+  suite_add_tcase(s, tc_histogram);
+#endif
+
+#ifdef POOL_TRACE
+  TCase* tc_trace = tcase_create("Event tracing");
+  tcase_add_test(tc_trace, trace_events);
+  tcase_add_test(tc_trace, trace_replay);
+  suite_add_tcase(s, tc_trace);
+#endif
   return s;
 }
 
@@ -368,6 +940,222 @@ START_TEST (unaligned_ptr)
   ck_assert_uint_eq(*((uint16_t*)unaligned_ptr), 0xFF);
 }
 END_TEST
+
+/*
+ * Test: free_in_full_region
+ * Description: A slot freed from a completely full region is handed out again
+ * Precondition: block_sizes = {32, 64}, fill the 32B region and free its 100th slot
+ * Postcondition: The next 20B request returns the freed slot instead of spilling into the 64B region
+ */
+START_TEST (free_in_full_region)
+{
+  size_t sizes_list[2] = {32, 64};
+  size_t num_elements = 2;
+  void* ptrs[SLOTS_32_OF_32_64];
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  for(size_t i = 0; i < SLOTS_32_OF_32_64; i++){
+    ptrs[i] = pool_malloc(20);
+  }
+  pool_free(ptrs[100]);
+
+  void* new_alloc = pool_malloc(20);
+  ck_assert_ptr_eq(new_alloc, ptrs[100]);
+}
+END_TEST
+
+/*
+ * Test: free_every_region
+ * Description: Pointers from every block-size region are freed back to their own region
+ * Precondition: block_sizes = {24, 12, 8, 16, 20}, one allocation per block size, all freed
+ * Postcondition: Repeating the same requests returns the same pointers
+ */
+START_TEST (free_every_region)
+{
+  size_t sizes_list[5] = {24, 12, 8, 16, 20};
+  size_t num_elements = 5;
+  size_t request_sizes[5] = {8, 12, 16, 20, 24};
+  void* ptrs[5];
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  for(size_t i = 0; i < num_elements; i++){
+    ptrs[i] = pool_malloc(request_sizes[i]);
+    ck_assert_ptr_ne(ptrs[i], NULL);
+  }
+  for(size_t i = 0; i < num_elements; i++){
+    pool_free(ptrs[i]);
+  }
+  for(size_t i = 0; i < num_elements; i++){
+    ck_assert_ptr_eq(pool_malloc(request_sizes[i]), ptrs[i]);
+  }
+}
+END_TEST
+
+/*
+ * Test: sized_free
+ * Description: Free by known request size, including an allocation that spilled into a larger block
+ * Precondition: block_sizes = {32, 64}, fill the 32B region, then one 20B request spills into the 64B region
+ * Postcondition: Both freed slots are handed out again by their own block size
+ */
+START_TEST (sized_free)
+{
+  size_t sizes_list[2] = {32, 64};
+  size_t num_elements = 2;
+  void* ptrs[SLOTS_32_OF_32_64];
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  for(size_t i = 0; i < SLOTS_32_OF_32_64; i++){
+    ptrs[i] = pool_malloc(20);
+  }
+  void* spilled = pool_malloc(20);
+  ck_assert_ptr_ne(spilled, NULL);
+
+  pool_free_sized(ptrs[5], 20);
+  pool_free_sized(spilled, 20);
+  ck_assert_ptr_eq(pool_malloc(40), spilled);
+  ck_assert_ptr_eq(pool_malloc(20), ptrs[5]);
+}
+END_TEST
+
+/*
+ * Test: bulk_free
+ * Description: Free a batch spanning both regions and several occupation map words, in shuffled runs
+ * Precondition: block_sizes = {32, 64}, 200 x 20B and 100 x 40B allocated in bulk, all freed in one call with a NULL entry
+ * Postcondition: A second bulk allocation returns the same pointers
+ */
+START_TEST (bulk_free)
+{
+  size_t sizes_list[2] = {32, 64};
+  void* ptrs[301];
+  void* again[300];
+
+  ck_assert(pool_init(sizes_list, 2));
+  ck_assert_uint_eq(pool_malloc_bulk(20, ptrs, 200), 200);
+  ck_assert_uint_eq(pool_malloc_bulk(40, ptrs + 200, 100), 100);
+  ptrs[300] = NULL;
+  // Interleave the regions so that runs break on every region change
+  for(size_t i = 0; i < 100; i += 2){
+    void* tmp = ptrs[i];
+    ptrs[i] = ptrs[200 + i];
+    ptrs[200 + i] = tmp;
+  }
+  pool_free_bulk(ptrs, 301);
+
+  ck_assert_uint_eq(pool_malloc_bulk(20, again, 200), 200);
+  ck_assert_uint_eq(pool_malloc_bulk(40, again + 200, 100), 100);
+  for(size_t i = 0; i < 100; i += 2){
+    void* tmp = again[i];
+    again[i] = again[200 + i];
+    again[200 + i] = tmp;
+  }
+  for(size_t i = 0; i < 300; i++){
+    ck_assert_ptr_eq(again[i], ptrs[i]);
+  }
+}
+END_TEST
+
+/*
+ * Test: realloc_resize
+ * Description: Resize a block within its block size, up into a larger one and back down
+ * Precondition: block_sizes = {32, 64, 128}, a 20B block filled with a pattern
+ * Postcondition: Resizing within 32B keeps the pointer; growing to 100B and shrinking to 10B move the block and keep its contents,
+ *                the shrink hands the 128B slot back, and invalid requests leave the block untouched
+ */
+START_TEST (realloc_resize)
+{
+  size_t sizes_list[3] = {32, 64, 128};
+
+  ck_assert(pool_init(sizes_list, 3));
+  uint8_t* ptr = pool_malloc(20);
+  ck_assert_ptr_ne(ptr, NULL);
+  for(size_t i = 0; i < 20; i++){
+    ptr[i] = (uint8_t)i;
+  }
+  ck_assert_uint_eq(pool_usable_size(ptr), 32);
+  ck_assert_ptr_eq(pool_realloc(ptr, 30), ptr);
+
+  uint8_t* grown = pool_realloc(ptr, 100);
+  ck_assert_ptr_ne(grown, NULL);
+  ck_assert_ptr_ne(grown, ptr);
+  ck_assert_uint_eq(pool_usable_size(grown), 128);
+  for(size_t i = 0; i < 20; i++){
+    ck_assert_uint_eq(grown[i], i);
+  }
+
+  uint8_t* shrunk = pool_realloc(grown, 10);
+  ck_assert_ptr_eq(shrunk, ptr);
+  for(size_t i = 0; i < 10; i++){
+    ck_assert_uint_eq(shrunk[i], i);
+  }
+  ck_assert_ptr_eq(pool_malloc(100), grown);
+
+  // Invalid pointers and sizes fail without touching the block
+  ck_assert_ptr_eq(pool_realloc(shrunk + 1, 10), NULL);
+  ck_assert_uint_eq(pool_usable_size(shrunk + 1), 0);
+  ck_assert_ptr_eq(pool_realloc(shrunk, 1000), NULL);
+  ck_assert_uint_eq(shrunk[9], 9);
+  // NULL allocates and size 0 frees
+  uint8_t* fresh = pool_realloc(NULL, 50);
+  ck_assert_uint_eq(pool_usable_size(fresh), 64);
+  ck_assert_ptr_eq(pool_realloc(fresh, 0), NULL);
+  ck_assert_ptr_eq(pool_malloc(50), fresh);
+}
+END_TEST
+
+/*
+ * Test: reset_and_mark
+ * Description: Free a whole pool at once, then roll nested phases back to their marks
+ * Precondition: block_sizes = {32, 64}, the 32B region filled and one 40B block allocated before pool_reset
+ * Postcondition: After the reset the 32B region holds exactly its capacity again and nothing is live; each release frees
+ *                only the blocks of its own phase
+ */
+START_TEST (reset_and_mark)
+{
+  size_t sizes_list[2] = {32, 64};
+  void* ptrs[SLOTS_32_OF_32_64];
+  pool_region_stats_t stats[2];
+
+  ck_assert(pool_init(sizes_list, 2));
+  ck_assert_uint_eq(pool_malloc_bulk(20, ptrs, SLOTS_32_OF_32_64), SLOTS_32_OF_32_64);
+  ck_assert_ptr_ne(pool_malloc(40), NULL);
+  pool_reset();
+  pool_stats(stats, 2);
+  ck_assert_uint_eq(stats[0].live, 0);
+  ck_assert_uint_eq(stats[1].live, 0);
+  // The padding bits past the last slot survive the reset, so the region fills to the same count and then spills
+  void* again[SLOTS_32_OF_32_64];
+  ck_assert_uint_eq(pool_malloc_bulk(20, again, SLOTS_32_OF_32_64), SLOTS_32_OF_32_64);
+  ck_assert_ptr_eq(again[0], ptrs[0]);
+  ck_assert_uint_eq(pool_usable_size(pool_malloc(20)), 64);
+  ck_assert(pool_reset_region(0));
+  ck_assert(pool_reset_region(1));
+  ck_assert(!pool_reset_region(2));
+
+  uint8_t outer_mark[pool_mark_size()];
+  uint8_t inner_mark[pool_mark_size()];
+  void* kept = pool_malloc(20);
+  pool_mark(outer_mark);
+  void* outer = pool_malloc(20);
+  pool_mark(inner_mark);
+  void* inner = pool_malloc(20);
+  ck_assert_ptr_ne(pool_malloc(40), NULL);
+  pool_release(inner_mark);
+  ck_assert_ptr_eq(pool_malloc(20), inner);
+  pool_release(inner_mark);
+  pool_stats(stats, 2);
+  ck_assert_uint_eq(stats[0].live, 2);
+  ck_assert_uint_eq(stats[1].live, 0);
+  pool_release(outer_mark);
+  ck_assert_ptr_eq(pool_malloc(20), outer);
+  pool_free(outer);
+  pool_free(kept);
+  pool_stats(stats, 2);
+  ck_assert_uint_eq(stats[0].live, 0);
+}
+END_TEST
 // END Test Suite: pool_free_suite
 
 
@@ -377,10 +1165,693 @@ Suite * pool_free_suite(void)
 
   TCase* tc_normal_free = tcase_create("Normal free");
   tcase_add_test(tc_normal_free, single_free);
+  tcase_add_test(tc_normal_free, free_in_full_region);
+  tcase_add_test(tc_normal_free, free_every_region);
+  tcase_add_test(tc_normal_free, sized_free);
+  tcase_add_test(tc_normal_free, bulk_free);
   suite_add_tcase(s, tc_normal_free);
 
+  TCase* tc_realloc = tcase_create("Resize");
+  tcase_add_test(tc_realloc, realloc_resize);
+  suite_add_tcase(s, tc_realloc);
+
+  TCase* tc_reset = tcase_create("Reset and mark/release");
+  tcase_add_test(tc_reset, reset_and_mark);
+  suite_add_tcase(s, tc_reset);
+
+  return s;
+}
+
+// START Test Suite: pool_instance_suite
+/*
+ * Test: independent_pools
+ * Description: Two pools built in caller-supplied buffers hand out memory from their own buffer only
+ * Precondition: Two 4 KiB buffers, block_sizes = {8} and {64, 16}, the default pool also initialized
+ * Postcondition: Pointers lie inside their own buffer; filling one pool leaves the other untouched
+ */
+START_TEST (independent_pools)
+{
+  static uint64_t buf_a[512];
+  static uint64_t buf_b[512];
+  size_t sizes_a[1] = {8};
+  size_t sizes_b[2] = {64, 16};
+
+  pool_t* pool_a = pool_create(buf_a, sizeof(buf_a), sizes_a, 1);
+  pool_t* pool_b = pool_create((uint8_t*)buf_b + 1, sizeof(buf_b) - 1, sizes_b, 2);
+  ck_assert_ptr_ne(pool_a, NULL);
+  ck_assert_ptr_ne(pool_b, NULL);
+  ck_assert(pool_init(sizes_b, 2));
+
+  uint8_t* ptr_b = pool_malloc_h(pool_b, 10);
+  ck_assert(ptr_b > (uint8_t*)buf_b && ptr_b < (uint8_t*)buf_b + sizeof(buf_b));
+  size_t count_a = 0;
+  uint8_t* ptr_a;
+  while((ptr_a = pool_malloc_h(pool_a, 8)) != NULL) {
+    ck_assert(ptr_a > (uint8_t*)buf_a && ptr_a < (uint8_t*)buf_a + sizeof(buf_a));
+    count_a++;
+  }
+  ck_assert_uint_gt(count_a, 0);
+  ck_assert_ptr_eq(pool_malloc_h(pool_a, 9), NULL);
+
+  // The other pools still have room, and a freed slot goes back to its own pool
+  ck_assert_ptr_ne(pool_malloc(10), NULL);
+  pool_free_h(pool_b, ptr_b);
+  ck_assert_ptr_eq(pool_malloc_h(pool_b, 10), ptr_b);
+  pool_free_sized_h(pool_b, ptr_b, 10);
+  ck_assert_ptr_eq(pool_malloc_h(pool_b, 16), ptr_b);
+}
+END_TEST
+
+/*
+ * Test: pool_create_bad_args
+ * Description: Reject memory areas that are missing, too small or too large
+ * Precondition: block_sizes = {32}
+ * Postcondition: NULL pool handle
+ */
+START_TEST (pool_create_bad_args)
+{
+  static uint64_t buf[512];
+  size_t sizes_list[1] = {32};
+
+  ck_assert_ptr_eq(pool_create(NULL, sizeof(buf), sizes_list, 1), NULL);
+  ck_assert_ptr_eq(pool_create(buf, 16, sizes_list, 1), NULL);
+  ck_assert_ptr_eq(pool_create(buf, 400, sizes_list, 1), NULL);
+  ck_assert_ptr_eq(pool_create(buf, (size_t)MAX_POOL_SIZE + 8, sizes_list, 1), NULL);
+  ck_assert_ptr_eq(pool_create(buf, sizeof(buf), sizes_list, 0), NULL);
+}
+END_TEST
+
+/*
+ * Test: aligned_regions
+ * Description: Per-block-size alignments are honored in a pool built in memory that is only word-aligned
+ * Precondition: block_sizes = {24, 17, 40, 100} with natural, packed, 16 B and cache-line alignment
+ * Postcondition: Regions report their alignment and padding; every 100B block starts a cache line; pool_aligned_alloc
+ *                spills a 64-aligned request into the 100B region and rejects alignments that are not powers of two
+ */
+START_TEST (aligned_regions)
+{
+  static uint64_t buf[2048] __attribute__((aligned(64)));
+  size_t sizes_list[4] = {24, 17, 40, 100};
+  size_t alignments[4] = {POOL_ALIGN_NATURAL, POOL_ALIGN_PACKED, 16, POOL_ALIGN_CACHE_LINE};
+  size_t bad_alignments[4] = {POOL_ALIGN_NATURAL, 48, 16, 8};
+  pool_region_stats_t stats[4];
+
+  ck_assert_ptr_eq(pool_create_aligned(buf + 1, sizeof(buf) - 8, sizes_list, bad_alignments, NULL, 4, POOL_SIZE_BY_WEIGHT, NULL), NULL);
+  pool_t* pool = pool_create_aligned(buf + 1, sizeof(buf) - 8, sizes_list, alignments, NULL, 4, POOL_SIZE_BY_WEIGHT, NULL);
+  ck_assert_ptr_ne(pool, NULL);
+
+  ck_assert_uint_eq(pool_stats_h(pool, stats, 4), 4);
+  ck_assert_uint_eq(stats[0].block_size, 17);
+  ck_assert_uint_eq(stats[0].padding, 0);
+  ck_assert_uint_eq(stats[1].block_size, 24);
+  ck_assert_uint_ge(stats[1].alignment, 8);
+  ck_assert_uint_eq(stats[1].padding, 0);
+  ck_assert_uint_eq(stats[2].block_size, 40);
+  ck_assert_uint_ge(stats[2].alignment, 16);
+  ck_assert_uint_ge(stats[2].padding, stats[2].capacity * 8);
+  ck_assert_uint_eq(stats[3].block_size, 100);
+  ck_assert_uint_ge(stats[3].alignment, 64);
+  ck_assert_uint_ge(stats[3].padding, stats[3].capacity * 28);
+
+  for(size_t i = 0; i < stats[3].capacity; i++){
+    uint8_t* ptr = pool_malloc_h(pool, 100);
+    ck_assert_ptr_ne(ptr, NULL);
+    ck_assert_uint_eq((uintptr_t)ptr % 64, 0);
+  }
+  ck_assert_ptr_eq(pool_aligned_alloc_h(pool, 64, 10), NULL);
+  pool_free_h(pool, pool_malloc_h(pool, 40));   // Leaves the 40B region as it was
+  ck_assert_ptr_ne(pool_aligned_alloc_h(pool, 16, 10), NULL);
+  ck_assert_ptr_eq(pool_aligned_alloc_h(pool, 3, 10), NULL);
+  ck_assert_ptr_eq(pool_aligned_alloc_h(pool, 0, 10), NULL);
+
+  pool_stats_h(pool, stats, 4);
+  ck_assert_uint_eq(stats[0].spills, 1);
+  ck_assert_uint_eq(stats[0].failures, 1);
+  ck_assert_uint_eq(stats[2].live, 1);
+}
+END_TEST
+
+/*
+ * Test: split_layout
+ * Description: The split layout keeps every occupation map ahead of the regions, which start on cache lines
+ * Precondition: block_sizes = {32, 64} with 100 and 70 blocks, built in memory that is only byte-aligned
+ * Postcondition: The pool and both regions start on cache lines; each region hands out exactly its blocks, back to back,
+ *                then spills; single and bulk frees return every block; invalid layouts are rejected
+ */
+START_TEST (split_layout)
+{
+  static uint64_t buf[2048] __attribute__((aligned(64)));
+  size_t sizes_list[2] = {32, 64};
+  size_t targets[2] = {100, 70};
+  size_t capacities[2];
+  void* ptrs[170];
+  pool_region_stats_t stats[2];
+
+  ck_assert_ptr_eq(pool_create_layout((uint8_t*)buf + 1, sizeof(buf) - 8, sizes_list, NULL, targets, 2, POOL_SIZE_BY_COUNT, (pool_layout_t)2, NULL), NULL);
+  pool_t* pool = pool_create_layout((uint8_t*)buf + 1, sizeof(buf) - 8, sizes_list, NULL, targets, 2, POOL_SIZE_BY_COUNT, POOL_LAYOUT_SPLIT, capacities);
+  ck_assert_ptr_ne(pool, NULL);
+  ck_assert_uint_eq((uintptr_t)pool % 64, 0);
+  ck_assert_uint_eq(capacities[0], 100);
+  ck_assert_uint_eq(capacities[1], 70);
+
+  for(size_t i = 0; i < 170; i++){
+    ptrs[i] = pool_malloc_h(pool, 20);
+    ck_assert_ptr_ne(ptrs[i], NULL);
+  }
+  ck_assert_ptr_eq(pool_malloc_h(pool, 20), NULL);
+  ck_assert_uint_eq((uintptr_t)ptrs[0] % 64, 0);
+  ck_assert_uint_eq((uintptr_t)ptrs[100] % 64, 0);
+  ck_assert_uint_ge((uintptr_t)ptrs[100], (uintptr_t)ptrs[99] + 32);
+  for(size_t i = 1; i < 100; i++){
+    ck_assert_ptr_eq(ptrs[i], (uint8_t*)ptrs[i - 1] + 32);
+  }
+
+  pool_stats_h(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].live, 100);
+  ck_assert_uint_eq(stats[1].live, 70);
+  ck_assert_uint_eq(stats[0].spills, 70);
+  ck_assert_uint_ge(stats[1].alignment, 64);
+
+  for(size_t i = 0; i < 100; i++){
+    pool_free_h(pool, ptrs[i]);
+  }
+  pool_free_bulk_h(pool, ptrs + 100, 70);
+  pool_free_h(pool, (uint8_t*)pool + 64);   // Metadata block
+  pool_stats_h(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].live, 0);
+  ck_assert_uint_eq(stats[1].live, 0);
+  uint8_t* ptr = pool_malloc_h(pool, 20);
+  ck_assert(((void*)ptr >= ptrs[0]) && ((void*)ptr <= ptrs[99]));
+}
+END_TEST
+
+/*
+ * Test: mapped_pool
+ * Description: A pool built in memory from pool_map works like any other and reports what the system granted
+ * Precondition: 64 KiB requested with huge pages and population, and no node binding
+ * Postcondition: The mapping is at least as long as requested and only reports options that were asked for;
+ *                a pool created in it hands out blocks, and a zero length is rejected
+ */
+START_TEST (mapped_pool)
+{
+  size_t sizes_list[2] = {32, 64};
+  size_t len = 65536;
+  unsigned granted;
+
+  size_t zero_len = 0;
+  ck_assert_ptr_eq(pool_map(&zero_len, POOL_MAP_DEFAULT, POOL_NUMA_ANY, NULL), NULL);
+  uint8_t* mem = pool_map(&len, POOL_MAP_HUGE_PAGES | POOL_MAP_POPULATE, POOL_NUMA_ANY, &granted);
+  ck_assert_ptr_ne(mem, NULL);
+  ck_assert_uint_ge(len, 65536);
+  ck_assert_uint_eq(granted & ~(unsigned)(POOL_MAP_HUGE_PAGES | POOL_MAP_TRANSPARENT_HUGE_PAGES | POOL_MAP_POPULATE), 0);
+  ck_assert(granted & POOL_MAP_POPULATE);
+
+  pool_t* pool = pool_create(mem, 65536, sizes_list, 2);
+  ck_assert_ptr_ne(pool, NULL);
+  void* ptr = pool_malloc_h(pool, 40);
+  ck_assert_ptr_ne(ptr, NULL);
+  ck_assert(((uint8_t*)ptr > mem) && ((uint8_t*)ptr < mem + 65536));
+  pool_free_h(pool, ptr);
+  pool_magazine_flush();
+  pool_unmap(mem, len);
+}
+END_TEST
+
+/*
+ * Test: persistent_pool
+ * Description: A file-backed pool keeps its blocks and root across detach and attach, and refuses other block sizes or a damaged header
+ * Precondition: block_sizes = {32, 64} in a 16 KiB pool file, a 20B block holding a string set as the root
+ * Postcondition: Attaching with the same block sizes in another order returns the root with its string and one live block;
+ *                other block sizes and a bad magic number are refused
+ */
+START_TEST (persistent_pool)
+{
+  char path[] = "/tmp/tbp_pool_XXXXXX";
+  int fd = mkstemp(path);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+  unlink(path);
+  size_t sizes_list[2] = {32, 64};
+  size_t swapped[2] = {64, 32};
+  size_t other[2] = {32, 128};
+  pool_region_stats_t stats[2];
+
+  pool_t* pool = pool_create_file(path, 16384, sizes_list, 2);
+  ck_assert_ptr_ne(pool, NULL);
+  ck_assert_ptr_eq(pool_create_file(path, 16384, sizes_list, 2), NULL);
+  char* name = pool_malloc_h(pool, 20);
+  strcpy(name, "warm restart");
+  pool_set_root(pool, name);
+  pool_detach(pool);
+
+  ck_assert_ptr_eq(pool_attach(path, other, 2), NULL);
+  ck_assert_ptr_eq(pool_attach(path, sizes_list, 1), NULL);
+  pool = pool_attach(path, swapped, 2);
+  ck_assert_ptr_ne(pool, NULL);
+  name = pool_root(pool);
+  ck_assert_str_eq(name, "warm restart");
+  pool_stats_h(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].live, 1);
+  ck_assert_ptr_ne(pool_malloc_h(pool, 20), name);
+  pool_detach(pool);
+
+  uint64_t bad_magic = 0;
+  fd = open(path, O_RDWR);
+  ck_assert_int_eq(pwrite(fd, &bad_magic, sizeof(bad_magic), 0), sizeof(bad_magic));
+  close(fd);
+  ck_assert_ptr_eq(pool_attach(path, NULL, 0), NULL);
+  unlink(path);
+}
+END_TEST
+
+#ifdef POOL_ELASTIC
+#define TEST_SLAB_LEN 4096
+#define TEST_SLABS 6
+
+static uint8_t g_slab_arena[TEST_SLABS][TEST_SLAB_LEN] __attribute__((aligned(TEST_SLAB_LEN)));
+static bool g_slab_used[TEST_SLABS];
+static size_t g_slab_releases;
+
+static void* testSlabAcquire(size_t len, void* ctx) {
+  (void)ctx;
+  ck_assert_uint_eq(len, TEST_SLAB_LEN);
+  for(size_t i = 0; i < TEST_SLABS; i++) {
+    if(!g_slab_used[i]) {
+      g_slab_used[i] = true;
+      return g_slab_arena[i];
+    }
+  }
+  return NULL;
+}
+
+static void testSlabRelease(void* mem, size_t len, void* ctx) {
+  (void)ctx;
+  (void)len;
+  g_slab_used[((uint8_t*)mem - g_slab_arena[0]) / TEST_SLAB_LEN] = false;
+  g_slab_releases++;
+}
+
+/*
+ * Test: elastic_growth
+ * Description: An elastic pool grows a full block size by slabs from a caller provider before spilling, and returns empty slabs past the threshold
+ * Precondition: block_sizes = {32, 256}, 4 KiB slabs from an arena of 6 (one holds the pool's bookkeeping), 1 empty slab kept
+ * Postcondition: 32B requests take every slab the provider has instead of spilling into the 256B block size; freeing
+ *                them keeps one empty slab and returns the rest; destroying the pool returns every slab. The default
+ *                provider maps slabs and unmaps them once empty
+ */
+START_TEST (elastic_growth)
+{
+  size_t sizes_list[2] = {256, 32};
+  pool_slab_provider_t provider = {testSlabAcquire, testSlabRelease, NULL};
+  pool_elastic_stats_t stats[2];
+  static void* ptrs[1024];
+
+  ck_assert_ptr_eq(pool_elastic_create(sizes_list, 2, 3000, 1, &provider), NULL);
+  pool_elastic_t* pool = pool_elastic_create(sizes_list, 2, TEST_SLAB_LEN, 1, &provider);
+  ck_assert_ptr_ne(pool, NULL);
+  ck_assert_uint_eq(pool_elastic_stats(pool, stats, 2), 2);
+  ck_assert_uint_eq(stats[0].block_size, 32);
+  ck_assert_uint_eq(stats[0].slabs, 0);
+
+  size_t count = 0;
+  while((ptrs[count] = pool_elastic_malloc(pool, 20)) != NULL) {
+    count++;
+  }
+  pool_elastic_stats(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].slabs, 5);
+  ck_assert_uint_eq(stats[0].live, stats[0].capacity);
+  ck_assert_uint_eq(stats[1].slabs, 0);
+  ck_assert_uint_eq(count, stats[0].capacity);
+
+  for(size_t i = 0; i < count; i++) {
+    pool_elastic_free(pool, ptrs[i]);
+  }
+  pool_elastic_stats(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].live, 0);
+  ck_assert_uint_eq(stats[0].slabs, 1);
+  ck_assert_uint_eq(stats[0].empty_slabs, 1);
+  ck_assert_uint_eq(stats[0].slab_releases, 4);
+  ck_assert_uint_eq(g_slab_releases, 4);
+
+  // Four slabs of 32B blocks leave the last slab to the 256B block size
+  for(size_t i = 0; i < count / 5 * 4; i++) {
+    ck_assert_ptr_ne(pool_elastic_malloc(pool, 20), NULL);
+  }
+  ck_assert_ptr_ne(pool_elastic_malloc(pool, 200), NULL);
+  ck_assert_ptr_eq(pool_elastic_malloc(pool, 300), NULL);
+  pool_elastic_stats(pool, stats, 2);
+  ck_assert_uint_eq(stats[0].slabs, 4);
+  ck_assert_uint_eq(stats[1].slabs, 1);
+  ck_assert_uint_eq(stats[1].live, 1);
+
+  pool_elastic_destroy(pool);
+  for(size_t i = 0; i < TEST_SLABS; i++) {
+    ck_assert(!g_slab_used[i]);
+  }
+
+  // Default provider: mapped slabs, none kept once empty
+  pool = pool_elastic_create(sizes_list, 2, 4 * TEST_SLAB_LEN, 0, NULL);
+  ck_assert_ptr_ne(pool, NULL);
+  void* ptr = pool_elastic_malloc(pool, 100);
+  ck_assert_ptr_ne(ptr, NULL);
+  pool_elastic_free(pool, ptr);
+  pool_elastic_stats(pool, stats, 2);
+  ck_assert_uint_eq(stats[1].slabs, 0);
+  ck_assert_uint_eq(stats[1].slab_releases, 1);
+  pool_elastic_destroy(pool);
+}
+END_TEST
+
+/*
+ * Test: elastic_slab_fit
+ * Description: Block sizes that do not fit a slab beside its metadata are refused when the elastic pool is created
+ * Precondition: 4 KiB slabs from the test arena; block_sizes = {16, 4000}, then {16, 2000}
+ * Postcondition: The first pool is not created and its bookkeeping slab goes back; the second one serves a 2000B
+ *                request from a single new slab
+ */
+START_TEST (elastic_slab_fit)
+{
+  size_t too_large[2] = {16, 4000};
+  size_t sizes_list[2] = {16, 2000};
+  pool_slab_provider_t provider = {testSlabAcquire, testSlabRelease, NULL};
+  pool_elastic_stats_t stats[2];
+
+  ck_assert_ptr_eq(pool_elastic_create(too_large, 2, TEST_SLAB_LEN, 0, &provider), NULL);
+  ck_assert_uint_eq(g_slab_releases, 1);
+  for(size_t i = 0; i < TEST_SLABS; i++) {
+    ck_assert(!g_slab_used[i]);
+  }
+
+  pool_elastic_t* pool = pool_elastic_create(sizes_list, 2, TEST_SLAB_LEN, 0, &provider);
+  ck_assert_ptr_ne(pool, NULL);
+  void* ptr = pool_elastic_malloc(pool, 2000);
+  ck_assert_ptr_ne(ptr, NULL);
+  pool_elastic_stats(pool, stats, 2);
+  ck_assert_uint_eq(stats[1].slab_acquires, 1);
+  ck_assert_uint_eq(stats[1].live, 1);
+  pool_elastic_free(pool, ptr);
+  pool_elastic_destroy(pool);
+}
+END_TEST
+#endif
+
+#ifdef POOL_LARGE
+/*
+ * Test: large_pool
+ * Description: Multi-megabyte pools hold far more than 65535 slots and blocks larger than 64 KiB
+ * Precondition: 32 MiB pool with block_sizes = {16}, filled, a slot deep inside it freed; 1 MiB pool with block_sizes = {100000}
+ * Postcondition: Slots are handed out in order, the freed slot is handed out again, and a 100000B request succeeds
+ */
+START_TEST (large_pool)
+{
+  size_t len = 32 << 20;
+  uint8_t* buf = malloc(len + (1 << 20));
+  size_t small_sizes[1] = {16};
+  size_t large_sizes[1] = {100000};
+  ck_assert_ptr_ne(buf, NULL);
+
+  pool_t* pool = pool_create(buf, len, small_sizes, 1);
+  ck_assert_ptr_ne(pool, NULL);
+  uint8_t* first = pool_malloc_h(pool, 16);
+  uint8_t* last = first;
+  size_t count = 1;
+  uint8_t* ptr;
+  while((ptr = pool_malloc_h(pool, 16)) != NULL) {
+    ck_assert_ptr_eq(ptr, last + 16);
+    last = ptr;
+    count++;
+  }
+  ck_assert_uint_gt(count, 2000000);
+  pool_free_h(pool, first + 16 * 1500000);
+  ck_assert_ptr_eq(pool_malloc_h(pool, 16), first + 16 * 1500000);
+
+  pool_t* large_pool = pool_create(buf + len, 1 << 20, large_sizes, 1);
+  ck_assert_ptr_ne(large_pool, NULL);
+  ck_assert_ptr_ne(pool_malloc_h(large_pool, 70000), NULL);
+  free(buf);
+}
+END_TEST
+#endif
+
+/*
+ * Test: pool_reuse
+ * Description: A pool built in the memory of an earlier one never sees blocks cached for the earlier one
+ * Precondition: a {16} pool with one block allocated and freed, destroyed; a {48} pool in the same memory, then a {16} one
+ *               built over it without pool_destroy_h; the default pool rebuilt after pool_destroy
+ * Postcondition: Blocks of the new pools are whole slots of their own block size, and every slot is handed out once
+ */
+START_TEST (pool_reuse)
+{
+  static uint8_t arena[4096];
+  size_t small_sizes[1] = {16};
+  size_t large_sizes[1] = {48};
+
+  pool_t* pool = pool_create(arena, sizeof(arena), small_sizes, 1);
+  ck_assert_ptr_ne(pool, NULL);
+  pool_free_h(pool, pool_malloc_h(pool, 16));
+  pool_destroy_h(pool);
+
+  pool_t* reused = pool_create(arena, sizeof(arena), large_sizes, 1);
+  ck_assert_ptr_eq(reused, pool);
+  uint8_t* first = pool_malloc_h(reused, 40);
+  uint8_t* second = pool_malloc_h(reused, 40);
+  ck_assert_ptr_ne(first, NULL);
+  ck_assert_ptr_ne(second, NULL);
+  ck_assert_uint_eq(pool_usable_size_h(reused, first), 48);
+  ck_assert_uint_eq(pool_usable_size_h(reused, second), 48);
+  ck_assert_uint_ge((first < second) ? (size_t)(second - first) : (size_t)(first - second), 48);
+  pool_free_h(reused, first);
+
+  // Rebuilt without pool_destroy_h: the slot just cached for the 48B pool must not come back
+  pool_t* rebuilt = pool_create(arena, sizeof(arena), small_sizes, 1);
+  ck_assert_ptr_eq(rebuilt, pool);
+  pool_region_stats_t stats;
+  ck_assert_uint_eq(pool_stats_h(rebuilt, &stats, 1), 1);
+  size_t count = 0;
+  while(pool_malloc_h(rebuilt, 16) != NULL){
+    count++;
+  }
+  ck_assert_uint_eq(count, stats.capacity);
+  pool_destroy_h(rebuilt);
+
+  bool result = pool_init(small_sizes, 1);
+  ck_assert(result);
+  pool_free(pool_malloc(16));
+  pool_destroy();
+  result = pool_init(large_sizes, 1);
+  ck_assert(result);
+  first = pool_malloc(40);
+  second = pool_malloc(40);
+  ck_assert_uint_eq(pool_usable_size(first), 48);
+  ck_assert_uint_eq(pool_usable_size(second), 48);
+  ck_assert_uint_ge((first < second) ? (size_t)(second - first) : (size_t)(first - second), 48);
+}
+END_TEST
+// END Test Suite: pool_instance_suite
+
+
+Suite * pool_instance_suite(void)
+{
+  Suite* s = suite_create("pool_instance");
+
+  TCase* tc_instances = tcase_create("Caller-supplied memory");
+  tcase_add_test(tc_instances, independent_pools);
+  tcase_add_test(tc_instances, pool_create_bad_args);
+  tcase_add_test(tc_instances, aligned_regions);
+  tcase_add_test(tc_instances, split_layout);
+  tcase_add_test(tc_instances, mapped_pool);
+  tcase_add_test(tc_instances, persistent_pool);
+  tcase_add_test(tc_instances, pool_reuse);
+#ifdef POOL_ELASTIC
+  tcase_add_test(tc_instances, elastic_growth);
+  tcase_add_test(tc_instances, elastic_slab_fit);
+#endif
+#ifdef POOL_LARGE
+  tcase_add_test(tc_instances, large_pool);
+#endif
+  suite_add_tcase(s, tc_instances);
+
+  return s;
+}
+
+#ifdef POOL_THREAD_SAFE
+// START Test Suite: pool_thread_suite
+/*
+ * Worker for concurrent_alloc_free: repeatedly allocates a batch, tags every block and
+ * checks that no tag was overwritten by another thread before freeing the batch.
+ * Returns a non-NULL value on corruption.
+ */
+static void* stressWorker(void* arg)
+{
+  uint64_t thread_id = (uintptr_t)arg;
+  uint64_t* ptrs[STRESS_BATCH];
+
+  for(uint64_t round = 0; round < STRESS_ROUNDS; round++){
+    size_t count = 0;
+    for(uint64_t k = 0; k < STRESS_BATCH; k++){
+      uint64_t* ptr = pool_malloc(8 + (k % 2) * 8);
+      if(ptr != NULL){
+        *ptr = (thread_id << 48) | (round << 16) | k;
+        ptrs[count++] = ptr;
+      }
+    }
+    for(size_t k = 0; k < count; k++){
+      if((*ptrs[k] >> 48) != thread_id){
+        return arg;
+      }
+      pool_free(ptrs[k]);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Test: concurrent_alloc_free
+ * Description: Several threads allocate and free concurrently without a lock
+ * Precondition: block_sizes = {16, 32}, STRESS_THREADS threads running stressWorker
+ * Postcondition: No block is handed to two threads at once, the region counters balance, and every slot is free again afterwards
+ */
+START_TEST (concurrent_alloc_free)
+{
+  size_t sizes_list[2] = {16, 32};
+  size_t num_elements = 2;
+  pthread_t threads[STRESS_THREADS];
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+
+  for(uintptr_t i = 0; i < STRESS_THREADS; i++){
+    ck_assert_int_eq(pthread_create(&threads[i], NULL, stressWorker, (void*)(i + 1)), 0);
+  }
+  for(size_t i = 0; i < STRESS_THREADS; i++){
+    void* thread_result;
+    pthread_join(threads[i], &thread_result);
+    ck_assert_ptr_eq(thread_result, NULL);
+  }
+
+  // Every thread's counts are in the totals once it has exited
+  pool_region_stats_t stats[2];
+  pool_stats(stats, 2);
+  for(size_t i = 0; i < 2; i++){
+    ck_assert_uint_eq(stats[i].live, 0);
+    ck_assert_uint_eq(stats[i].allocs, stats[i].frees);
+    ck_assert_uint_le(stats[i].high_water, stats[i].capacity);
+  }
+  ck_assert_uint_gt(stats[0].allocs, 0);
+
+  // With MAX_HEAP_SIZE = 65536, we should get
+  // SLOTS_16_32 slices over the 16B and 32B regions together
+  size_t capacity = 0;
+  while(pool_malloc(16) != NULL){
+    capacity++;
+  }
+  ck_assert_uint_eq(capacity, SLOTS_16_32);
+}
+END_TEST
+
+#ifdef POOL_MAGAZINES
+/*
+ * Test: magazine_hit_rate
+ * Description: Repeated alloc/free of one size is served from the calling thread's cache
+ * Precondition: block_sizes = {16, 32}, 100 rounds of a 16B allocation and free
+ * Postcondition: One refill, 99 cache hits, every free cached and nothing flushed
+ */
+START_TEST (magazine_hit_rate)
+{
+  size_t sizes_list[2] = {16, 32};
+  size_t num_elements = 2;
+  pool_magazine_stats_t stats;
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  for(size_t i = 0; i < 100; i++){
+    pool_free(pool_malloc(16));
+  }
+
+  pool_magazine_stats(&stats);
+  ck_assert_uint_eq(stats.alloc_refills, 1);
+  ck_assert_uint_eq(stats.alloc_hits, 99);
+  ck_assert_uint_eq(stats.free_hits, 100);
+  ck_assert_uint_eq(stats.free_flushes, 0);
+}
+END_TEST
+
+/*
+ * Test: magazine_double_free
+ * Description: Freeing a slot that is still cached in the calling thread's magazine traps
+ * Precondition: block_sizes = {16, 32}, a 16B block freed twice
+ * Postcondition: The second free raises SIGABRT instead of caching the slot again
+ */
+START_TEST (magazine_double_free)
+{
+  size_t sizes_list[2] = {16, 32};
+  size_t num_elements = 2;
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  void* ptr = pool_malloc(16);
+  ck_assert_ptr_ne(ptr, NULL);
+  pool_free(ptr);
+  pool_free(ptr);
+}
+END_TEST
+
+/*
+ * Worker for magazine_thread_exit: leaves a refilled batch of slots in its cache when it exits
+ */
+static void* cachingWorker(void* arg)
+{
+  (void)arg;
+  pool_free(pool_malloc(16));
+  return NULL;
+}
+
+/*
+ * Test: magazine_thread_exit
+ * Description: A thread's cached slots go back to the occupation maps when it exits
+ * Precondition: block_sizes = {16, 32}, a thread that caches a batch of 16B slots and exits
+ * Postcondition: The main thread can still allocate every slot of the pool
+ */
+START_TEST (magazine_thread_exit)
+{
+  size_t sizes_list[2] = {16, 32};
+  size_t num_elements = 2;
+  pthread_t thread;
+
+  bool result = pool_init(sizes_list, num_elements);
+  ck_assert(result);
+  ck_assert_int_eq(pthread_create(&thread, NULL, cachingWorker, NULL), 0);
+  pthread_join(thread, NULL);
+
+  size_t capacity = 0;
+  while(pool_malloc(16) != NULL){
+    capacity++;
+  }
+  ck_assert_uint_eq(capacity, SLOTS_16_32);
+}
+END_TEST
+#endif
+// END Test Suite: pool_thread_suite
+
+Suite * pool_thread_suite(void)
+{
+  Suite* s = suite_create("pool_thread");
+
+  TCase* tc_concurrent = tcase_create("Concurrent allocation");
+  tcase_add_test(tc_concurrent, concurrent_alloc_free);
+  suite_add_tcase(s, tc_concurrent);
+
+#ifdef POOL_MAGAZINES
+  TCase* tc_magazines = tcase_create("Per-thread slot caches");
+  tcase_add_test(tc_magazines, magazine_hit_rate);
+  tcase_add_test(tc_magazines, magazine_thread_exit);
+  tcase_add_test_raise_signal(tc_magazines, magazine_double_free, SIGABRT);
+  suite_add_tcase(s, tc_magazines);
+#endif
+
   return s;
 }
+#endif
 
 int main(void)
 {
@@ -390,6 +1861,10 @@ int main(void)
     SRunner* sr = srunner_create(init_suite);
     srunner_add_suite(sr, pool_malloc_suite());
     srunner_add_suite(sr, pool_free_suite());
+    srunner_add_suite(sr, pool_instance_suite());
+#ifdef POOL_THREAD_SAFE
+    srunner_add_suite(sr, pool_thread_suite());
+#endif
 
     srunner_run_all(sr, CK_NORMAL);
     number_failed = srunner_ntests_failed(sr);
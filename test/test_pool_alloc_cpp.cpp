@@ -0,0 +1,285 @@
+#include <config.h>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <new>
+#include <vector>
+#include <check.h>
+
+#include "include/pool_alloc.hpp"
+
+using pool_alloc::PoolAllocator;
+using pool_alloc::PoolScope;
+
+// Sum of the live counts of every region of pool
+static uint64_t liveBlocks(pool_t* pool)
+{
+  pool_region_stats_t stats[4];
+  size_t count = pool_stats_h(pool, stats, 4);
+  uint64_t live = 0;
+  for(size_t i = 0; i < count; i++){
+    live += stats[i].live;
+  }
+  return live;
+}
+
+struct alignas(32) Wide {
+  uint8_t bytes[32];
+};
+
+// BEGIN Test Suite: pool_alloc_cpp_suite
+/*
+ * Test: allocator_containers
+ * Description: Standard containers run on a PoolAllocator, and give every block back when cleared
+ * Precondition: a {32, 64, 256} pool; a list, a map and a vector of ints over it
+ * Postcondition: Contents survive the container's growth, and the pool has no live block once they are cleared
+ */
+START_TEST (allocator_containers)
+{
+  static uint8_t arena[16384];
+  size_t sizes_list[3] = {32, 64, 256};
+  pool_t* pool = pool_create(arena, sizeof(arena), sizes_list, 3);
+  ck_assert_ptr_ne(pool, NULL);
+
+  {
+    std::list<int, PoolAllocator<int>> list{PoolAllocator<int>(pool)};
+    std::map<int, int, std::less<int>, PoolAllocator<std::pair<const int, int>>> map{PoolAllocator<std::pair<const int, int>>(pool)};
+    std::vector<int, PoolAllocator<int>> vector{PoolAllocator<int>(pool)};
+    for(int i = 0; i < 50; i++){
+      list.push_back(i);
+      map[i] = i * i;
+      vector.push_back(i);
+    }
+    ck_assert_uint_gt(liveBlocks(pool), 100);
+
+    int expected = 0;
+    for(int value : list){
+      ck_assert_int_eq(value, expected++);
+    }
+    for(int i = 0; i < 50; i++){
+      ck_assert_int_eq(map[i], i * i);
+      ck_assert_int_eq(vector[i], i);
+    }
+    ck_assert(list.get_allocator() == vector.get_allocator());
+    ck_assert(list.get_allocator() != PoolAllocator<int>());
+  }
+  ck_assert_uint_eq(liveBlocks(pool), 0);
+  pool_destroy_h(pool);
+}
+END_TEST
+
+/*
+ * Test: allocator_alignment
+ * Description: PoolAllocator<T> takes its blocks from a region aligned to alignof(T)
+ * Precondition: a {32, 64} pool with a packed 32B region and a 64B region aligned to 64; a vector of alignas(32) elements
+ * Postcondition: Every element is 32-byte aligned; a single element is served by the 64B region unless the packed one is aligned enough
+ */
+START_TEST (allocator_alignment)
+{
+  static uint8_t arena[8192];
+  size_t sizes_list[2] = {32, 64};
+  size_t alignments[2] = {POOL_ALIGN_PACKED, 64};
+  pool_t* pool = pool_create_aligned(arena + 1, sizeof(arena) - 1, sizes_list, alignments, NULL, 2, POOL_SIZE_BY_WEIGHT, NULL);
+  ck_assert_ptr_ne(pool, NULL);
+  pool_region_stats_t stats[2];
+  ck_assert_uint_eq(pool_stats_h(pool, stats, 2), 2);
+
+  PoolAllocator<Wide> allocator(pool);
+  Wide* single = allocator.allocate(1);
+  ck_assert_uint_eq((uintptr_t)single % alignof(Wide), 0);
+  if(stats[0].alignment < alignof(Wide)){
+    ck_assert_uint_eq(pool_usable_size_h(pool, single), 64);
+  }
+  allocator.deallocate(single, 1);
+
+  {
+    std::vector<Wide, PoolAllocator<Wide>> vector(allocator);
+    for(int i = 0; i < 2; i++){
+      vector.push_back(Wide());
+      for(const Wide& element : vector){
+        ck_assert_uint_eq((uintptr_t)&element % alignof(Wide), 0);
+      }
+    }
+  }
+  ck_assert_uint_eq(liveBlocks(pool), 0);
+  pool_destroy_h(pool);
+}
+END_TEST
+
+/*
+ * Test: allocator_exhausted
+ * Description: PoolAllocator throws std::bad_alloc for requests the pool cannot serve
+ * Precondition: a {32} pool; a vector reserving more than one block, then a list grown until the pool runs out
+ * Postcondition: Both throw std::bad_alloc; the list holds one node per block of the pool when it does
+ */
+START_TEST (allocator_exhausted)
+{
+  static uint8_t arena[1024];
+  size_t sizes_list[1] = {32};
+  pool_t* pool = pool_create(arena, sizeof(arena), sizes_list, 1);
+  ck_assert_ptr_ne(pool, NULL);
+  pool_region_stats_t stats;
+  ck_assert_uint_eq(pool_stats_h(pool, &stats, 1), 1);
+
+  std::vector<uint64_t, PoolAllocator<uint64_t>> vector{PoolAllocator<uint64_t>(pool)};
+  bool thrown = false;
+  try {
+    vector.reserve(5);
+  } catch(const std::bad_alloc&) {
+    thrown = true;
+  }
+  ck_assert(thrown);
+
+  std::list<int, PoolAllocator<int>> list{PoolAllocator<int>(pool)};
+  thrown = false;
+  try {
+    for(size_t i = 0; i <= stats.capacity; i++){
+      list.push_back(0);
+    }
+  } catch(const std::bad_alloc&) {
+    thrown = true;
+  }
+  ck_assert(thrown);
+  ck_assert_uint_eq(list.size(), stats.capacity);
+  list.clear();
+  pool_destroy_h(pool);
+}
+END_TEST
+
+/*
+ * Test: scope_rollback
+ * Description: A PoolScope frees every block allocated while it was open
+ * Precondition: a {16, 64} pool with one block allocated before the scope; blocks allocated through a PoolAllocator inside it
+ *               and left live when it closes
+ * Postcondition: Only the block from before the scope is live afterwards, and the first block of the scope is handed out again
+ */
+START_TEST (scope_rollback)
+{
+  static uint8_t arena[4096];
+  size_t sizes_list[2] = {16, 64};
+  pool_t* pool = pool_create(arena, sizeof(arena), sizes_list, 2);
+  ck_assert_ptr_ne(pool, NULL);
+  void* before = pool_malloc_h(pool, 16);
+  ck_assert_ptr_ne(before, NULL);
+
+  void* first = NULL;
+  {
+    PoolScope scope(pool);
+    PoolAllocator<uint64_t> allocator(pool);
+    first = allocator.allocate(2);
+    for(int i = 0; i < 10; i++){
+      allocator.allocate(1 + (i % 8));
+    }
+    ck_assert_uint_eq(liveBlocks(pool), 12);
+  }
+  ck_assert_uint_eq(liveBlocks(pool), 1);
+  ck_assert_ptr_eq(pool_malloc_h(pool, 16), first);
+  pool_destroy_h(pool);
+}
+END_TEST
+
+#ifdef POOL_ALLOC_HAS_PMR
+/*
+ * Test: resource_pmr_vector
+ * Description: A std::pmr::vector grows inside the pool of its PoolResource
+ * Precondition: a {64, 256, 1024} pool; a pmr vector of 200 ints over a PoolResource on it
+ * Postcondition: The storage lies in the pool's memory, and the pool has no live block once the vector is gone
+ */
+START_TEST (resource_pmr_vector)
+{
+  static uint8_t arena[16384];
+  size_t sizes_list[3] = {64, 256, 1024};
+  pool_t* pool = pool_create(arena, sizeof(arena), sizes_list, 3);
+  ck_assert_ptr_ne(pool, NULL);
+  pool_alloc::PoolResource resource(pool);
+
+  {
+    std::pmr::vector<int> vector(&resource);
+    for(int i = 0; i < 200; i++){
+      vector.push_back(i);
+    }
+    ck_assert((uint8_t*)vector.data() >= arena);
+    ck_assert((uint8_t*)(vector.data() + vector.size()) <= arena + sizeof(arena));
+    for(int i = 0; i < 200; i++){
+      ck_assert_int_eq(vector[i], i);
+    }
+    ck_assert_uint_eq(liveBlocks(pool), 1);
+
+    bool thrown = false;
+    try {
+      vector.reserve(1024);
+    } catch(const std::bad_alloc&) {
+      thrown = true;
+    }
+    ck_assert(thrown);
+  }
+  ck_assert_uint_eq(liveBlocks(pool), 0);
+  pool_destroy_h(pool);
+}
+END_TEST
+
+/*
+ * Test: resource_is_equal
+ * Description: PoolResources compare equal exactly when they share a pool
+ * Precondition: two resources over one pool, one over a second pool, one over the default pool, and new_delete_resource
+ * Postcondition: Only the two resources over the same pool compare equal
+ */
+START_TEST (resource_is_equal)
+{
+  static uint8_t arena[2][1024];
+  size_t sizes_list[1] = {32};
+  pool_t* pool = pool_create(arena[0], sizeof(arena[0]), sizes_list, 1);
+  pool_t* other_pool = pool_create(arena[1], sizeof(arena[1]), sizes_list, 1);
+  ck_assert_ptr_ne(pool, NULL);
+  ck_assert_ptr_ne(other_pool, NULL);
+
+  pool_alloc::PoolResource resource(pool);
+  pool_alloc::PoolResource same(pool);
+  pool_alloc::PoolResource other(other_pool);
+  pool_alloc::PoolResource global;
+  ck_assert(resource.is_equal(same));
+  ck_assert(resource == same);
+  ck_assert(!resource.is_equal(other));
+  ck_assert(!resource.is_equal(global));
+  ck_assert(!resource.is_equal(*std::pmr::new_delete_resource()));
+  ck_assert(!std::pmr::new_delete_resource()->is_equal(resource));
+  pool_destroy_h(pool);
+  pool_destroy_h(other_pool);
+}
+END_TEST
+#endif
+// END Test Suite: pool_alloc_cpp_suite
+
+Suite * pool_alloc_cpp_suite(void)
+{
+  Suite* s = suite_create("pool_alloc_cpp");
+
+  TCase* tc_allocator = tcase_create("Standard allocator");
+  tcase_add_test(tc_allocator, allocator_containers);
+  tcase_add_test(tc_allocator, allocator_alignment);
+  tcase_add_test(tc_allocator, allocator_exhausted);
+  tcase_add_test(tc_allocator, scope_rollback);
+  suite_add_tcase(s, tc_allocator);
+
+#ifdef POOL_ALLOC_HAS_PMR
+  TCase* tc_resource = tcase_create("Polymorphic memory resource");
+  tcase_add_test(tc_resource, resource_pmr_vector);
+  tcase_add_test(tc_resource, resource_is_equal);
+  suite_add_tcase(s, tc_resource);
+#endif
+
+  return s;
+}
+
+int main(void)
+{
+    int number_failed;
+
+    SRunner* sr = srunner_create(pool_alloc_cpp_suite());
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
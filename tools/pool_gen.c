@@ -0,0 +1,187 @@
+/*
+ ============================================================================
+ Name        : pool_gen.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Generates a C header with a pool whose block sizes, block counts
+               and region addresses are compile-time constants
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include "include/pool_alloc.h"
+
+#define OCC_WORD_BITS 64
+
+static void usage(const char* prog) {
+  fprintf(stderr, "Usage: %s <prefix> <pool bytes> <block size>[:<count>] ...\n", prog);
+  fprintf(stderr, "Block counts are those pool_create gives a pool of that many bytes, or the given counts when every block size has one\n");
+}
+
+static bool validPrefix(const char* prefix) {
+  if(!isalpha((unsigned char)prefix[0]) && (prefix[0] != '_')) {
+    return false;
+  }
+  for(const char* c = prefix; *c != '\0'; c++) {
+    if(!isalnum((unsigned char)*c) && (*c != '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Writes the header for block_sizes[0..n) in ascending order with the given block counts.
+ */
+static void emitHeader(const char* prefix, size_t pool_bytes, const size_t* block_sizes, const size_t* counts, size_t n) {
+  char upper[256];
+  char guard[256 + sizeof("_POOL_H")];
+  size_t len = 0;
+  for(const char* c = prefix; (*c != '\0') && (len < sizeof(upper) - 1); c++) {
+    upper[len++] = (char)toupper((unsigned char)*c);
+  }
+  upper[len] = '\0';
+  snprintf(guard, sizeof(guard), "%s_POOL_H", upper);
+
+  printf("/*\n * Generated by pool_gen %s %zu", prefix, pool_bytes);
+  for(size_t i = 0; i < n; i++) {
+    printf(" %zu:%zu", block_sizes[i], counts[i]);
+  }
+  printf("\n *\n");
+  printf(" * A pool with its block sizes, block counts and region addresses fixed at compile time: size-class selection is a\n");
+  printf(" * chain of constant compares, and slot numbers come from constant divisions. Same contract as pool_malloc/pool_free,\n");
+  printf(" * without thread safety. Include it in one translation unit; every includer gets its own pool.\n */\n\n");
+  printf("#ifndef %s\n#define %s\n\n", guard, guard);
+  printf("#include <stddef.h>\n#include <stdint.h>\n#include <assert.h>\n\n");
+  printf("#define %s_NUM_BLOCK_SIZES %zu\n", upper, n);
+  printf("#define %s_MAX_BLOCK_SIZE %zu\n\n", upper, block_sizes[n - 1]);
+
+  // Occupation maps first, packed together, then each region's slots on a cache line
+  for(size_t i = 0; i < n; i++) {
+    size_t words = (counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+    size_t remainder = counts[i] % OCC_WORD_BITS;
+    printf("static uint64_t %s_map_%zu[%zu]", prefix, i, words);
+    if(remainder > 0) {
+      // Slots past the end of the region are marked occupied
+      printf(" = {[%zu] = ~((UINT64_C(1) << %zu) - 1)}", words - 1, remainder);
+    }
+    printf(";\n");
+  }
+  printf("static size_t %s_hint[%zu];\n", prefix, n);
+  for(size_t i = 0; i < n; i++) {
+    printf("static uint8_t %s_slots_%zu[%zu] __attribute__((aligned(64)));   // %zu blocks of %zu B\n", prefix, i, counts[i] * block_sizes[i], counts[i], block_sizes[i]);
+  }
+
+  printf("\nstatic inline void* %s_claim(uint64_t* map, size_t words, size_t* hint, uint8_t* slots, size_t block_size) {\n", prefix);
+  printf("  for(size_t w = *hint; w < words; w++) {\n");
+  printf("    uint64_t free_bits = ~map[w];\n");
+  printf("    if(free_bits != 0) {\n");
+  printf("      unsigned bit = (unsigned)__builtin_ctzll(free_bits);\n");
+  printf("      map[w] |= UINT64_C(1) << bit;\n");
+  printf("      *hint = w;\n");
+  printf("      return slots + (w * %d + bit) * block_size;\n", OCC_WORD_BITS);
+  printf("    }\n  }\n");
+  printf("  *hint = words;\n  return NULL;\n}\n\n");
+
+  printf("static inline void %s_release(uint64_t* map, size_t* hint, uint8_t* slots, size_t block_size, uint8_t* ptr) {\n", prefix);
+  printf("  size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)slots);\n");
+  printf("  assert(offset %% block_size == 0);   // Trap on unaligned pointers\n");
+  printf("  size_t slot = offset / block_size;\n");
+  printf("  uint64_t mask = UINT64_C(1) << (slot %% %d);\n", OCC_WORD_BITS);
+  printf("  assert(map[slot / %d] & mask);      // Trap on double frees\n", OCC_WORD_BITS);
+  printf("  map[slot / %d] &= ~mask;\n", OCC_WORD_BITS);
+  printf("  if(slot / %d < *hint) {\n    *hint = slot / %d;\n  }\n}\n\n", OCC_WORD_BITS, OCC_WORD_BITS);
+
+  // Each block size that fits n is tried in turn, so a full block size spills into the next one
+  printf("/* Allocates a block of at least n bytes; NULL if n is 0 or no block size that fits has a free block */\n");
+  printf("static inline void* %s_malloc(size_t n) {\n  void* ptr;\n", prefix);
+  printf("  if(n == 0) {\n    return NULL;\n  }\n");
+  for(size_t i = 0; i < n; i++) {
+    size_t words = (counts[i] + OCC_WORD_BITS - 1) / OCC_WORD_BITS;
+    printf("  if((n <= %zu) && ((ptr = %s_claim(%s_map_%zu, %zu, &%s_hint[%zu], %s_slots_%zu, %zu)) != NULL)) {\n    return ptr;\n  }\n",
+           block_sizes[i], prefix, prefix, i, words, prefix, i, prefix, i, block_sizes[i]);
+  }
+  printf("  return NULL;\n}\n\n");
+
+  printf("/* Frees a block from %s_malloc; pointers from elsewhere are ignored */\n", prefix);
+  printf("static inline void %s_free(void* ptr) {\n", prefix);
+  for(size_t i = 0; i < n; i++) {
+    printf("  if((uintptr_t)ptr - (uintptr_t)%s_slots_%zu < sizeof(%s_slots_%zu)) {\n", prefix, i, prefix, i);
+    printf("    %s_release(%s_map_%zu, &%s_hint[%zu], %s_slots_%zu, %zu, ptr);\n    return;\n  }\n", prefix, prefix, i, prefix, i, prefix, i, block_sizes[i]);
+  }
+  printf("}\n\n");
+
+  printf("/* Frees a block whose requested size n is known; skips the regions of block sizes smaller than n */\n");
+  printf("static inline void %s_free_sized(void* ptr, size_t n) {\n", prefix);
+  for(size_t i = 0; i < n; i++) {
+    printf("  if((n <= %zu) && ((uintptr_t)ptr - (uintptr_t)%s_slots_%zu < sizeof(%s_slots_%zu))) {\n", block_sizes[i], prefix, i, prefix, i);
+    printf("    %s_release(%s_map_%zu, &%s_hint[%zu], %s_slots_%zu, %zu, ptr);\n    return;\n  }\n", prefix, prefix, i, prefix, i, prefix, i, block_sizes[i]);
+  }
+  printf("  %s_free(ptr);\n}\n\n", prefix);
+  printf("#endif /* %s */\n", guard);
+}
+
+int main(int argc, char** argv) {
+  if(argc < 4) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char* prefix = argv[1];
+  size_t pool_bytes = strtoull(argv[2], NULL, 0);
+  size_t n = argc - 3;
+  if(!validPrefix(prefix) || (pool_bytes == 0) || (pool_bytes > MAX_POOL_SIZE) || (n > UCHAR_MAX)) {
+    fprintf(stderr, "The prefix must be a C identifier, pool bytes 1..%zu and at most %d block sizes\n", (size_t)MAX_POOL_SIZE, UCHAR_MAX);
+    return EXIT_FAILURE;
+  }
+
+  size_t block_sizes[UCHAR_MAX];
+  size_t targets[UCHAR_MAX];
+  size_t num_targets = 0;
+  for(size_t i = 0; i < n; i++) {
+    char* end;
+    block_sizes[i] = strtoull(argv[3 + i], &end, 0);
+    if(*end == ':') {
+      targets[i] = strtoull(end + 1, &end, 0);
+      num_targets++;
+    }
+    if((*end != '\0') || (block_sizes[i] == 0)) {
+      fprintf(stderr, "Invalid block size %s\n", argv[3 + i]);
+      return EXIT_FAILURE;
+    }
+  }
+  if((num_targets != 0) && (num_targets != n)) {
+    fprintf(stderr, "Give a count for every block size or for none\n");
+    return EXIT_FAILURE;
+  }
+
+  // Size the regions exactly as pool_create/pool_create_sized would for a pool of pool_bytes; the header goes to stdout, errors to stderr
+  void* mem = malloc(pool_bytes);
+  size_t capacities[UCHAR_MAX];
+  pool_t* pool = (num_targets == 0) ? pool_create(mem, pool_bytes, block_sizes, n)
+                                    : pool_create_sized(mem, pool_bytes, block_sizes, targets, n, POOL_SIZE_BY_COUNT, capacities);
+  if(pool == NULL) {
+    fprintf(stderr, "The block sizes do not fit in %zu bytes\n", pool_bytes);
+    free(mem);
+    return EXIT_FAILURE;
+  }
+  pool_region_stats_t stats[UCHAR_MAX];
+  pool_stats_h(pool, stats, n);
+  size_t sorted_sizes[UCHAR_MAX];
+  size_t counts[UCHAR_MAX];
+  for(size_t i = 0; i < n; i++) {
+    sorted_sizes[i] = stats[i].block_size;
+    counts[i] = stats[i].capacity;
+  }
+  free(mem);
+
+  emitHeader(prefix, pool_bytes, sorted_sizes, counts, n);
+  return EXIT_SUCCESS;
+}
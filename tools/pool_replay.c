@@ -0,0 +1,249 @@
+/*
+ ============================================================================
+ Name        : pool_replay.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Replays an allocation trace written by pool_trace_dump against
+               a block_sizes configuration and reports failures, spills and
+               fragmentation over the course of the trace
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+
+#include "include/pool_alloc.h"
+
+#define DEFAULT_WINDOWS 10
+#define SLOT_EMPTY 0
+#define SLOT_DELETED 1       // Block addresses are never 1, so it can mark a freed entry
+
+// Block of the replayed pool standing in for a block of the traced one
+typedef struct {
+  uint64_t traced;
+  void* ptr;
+  size_t size;
+} live_block_t;
+
+typedef struct {
+  live_block_t* slots;
+  size_t mask;
+} live_map_t;
+
+static void usage(const char* prog) {
+  printf("Usage: %s [-w windows] [-s] <trace file> <pool bytes> <block size> ...\n", prog);
+  printf("Replays the events of the first pool in the trace; %d windows by default\n", DEFAULT_WINDOWS);
+  printf("-s splits larger free slots for full block sizes, as pool_set_splitting does\n");
+}
+
+static live_block_t* liveFind(live_map_t* map, uint64_t traced, bool insert) {
+  size_t idx = (size_t)((traced >> 3) * UINT64_C(0x9E3779B97F4A7C15)) & map->mask;
+  live_block_t* reuse = NULL;
+  for(;;) {
+    live_block_t* slot = &map->slots[idx];
+    if(slot->traced == traced) {
+      return slot;
+    }
+    if((slot->traced == SLOT_DELETED) && (reuse == NULL)) {
+      reuse = slot;
+    }
+    if(slot->traced == SLOT_EMPTY) {
+      return !insert ? NULL : (reuse != NULL) ? reuse : slot;
+    }
+    idx = (idx + 1) & map->mask;
+  }
+}
+
+/*
+ * Reads a trace file. Returns the number of events, or 0 on errors.
+ */
+static size_t readTrace(const char* path, pool_trace_header_t* header, pool_trace_event_t** events) {
+  FILE* in = fopen(path, "rb");
+  if(in == NULL) {
+    printf("Cannot open %s\n", path);
+    return 0;
+  }
+  size_t num_events = 0;
+  if((fread(header, sizeof(*header), 1, in) != 1) || (header->magic != POOL_TRACE_MAGIC) || (header->version != POOL_TRACE_VERSION)
+     || (header->event_len != sizeof(pool_trace_event_t))) {
+    printf("%s is not a trace of this version\n", path);
+  } else {
+    *events = malloc((header->num_events + 1) * sizeof(pool_trace_event_t));
+    num_events = fread(*events, sizeof(pool_trace_event_t), header->num_events, in);
+    if(num_events != header->num_events) {
+      printf("%s is truncated: %zu of %llu events\n", path, num_events, (unsigned long long)header->num_events);
+    }
+  }
+  fclose(in);
+  return num_events;
+}
+
+static void sumStats(pool_t* pool, size_t num_block_size, uint64_t* spills, uint64_t* free_bytes) {
+  pool_region_stats_t stats[UCHAR_MAX];
+  pool_stats_h(pool, stats, num_block_size);
+  *spills = 0;
+  *free_bytes = 0;
+  for(size_t i = 0; i < num_block_size; i++) {
+    *spills += stats[i].spills;
+    *free_bytes += (stats[i].capacity - stats[i].live) * stats[i].block_size;
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t windows = DEFAULT_WINDOWS;
+  bool splitting = false;
+  int arg = 1;
+  for(;;) {
+    if((argc > arg + 1) && (strcmp(argv[arg], "-w") == 0)) {
+      windows = strtoull(argv[arg + 1], NULL, 0);
+      arg += 2;
+    } else if((argc > arg) && (strcmp(argv[arg], "-s") == 0)) {
+      splitting = true;
+      arg++;
+    } else {
+      break;
+    }
+  }
+  if((argc - arg < 3) || (windows == 0)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char* path = argv[arg];
+  size_t pool_bytes = strtoull(argv[arg + 1], NULL, 0);
+  size_t num_block_size = argc - arg - 2;
+  if((pool_bytes == 0) || (pool_bytes > MAX_POOL_SIZE) || (num_block_size > UCHAR_MAX)) {
+    printf("Pool bytes must be 1..%zu and at most %d block sizes given\n", (size_t)MAX_POOL_SIZE, UCHAR_MAX);
+    return EXIT_FAILURE;
+  }
+  size_t block_sizes[UCHAR_MAX];
+  for(size_t i = 0; i < num_block_size; i++) {
+    block_sizes[i] = strtoull(argv[arg + 2 + i], NULL, 0);
+  }
+
+  pool_trace_header_t header;
+  pool_trace_event_t* events = NULL;
+  size_t num_events = readTrace(path, &header, &events);
+  if(num_events == 0) {
+    free(events);
+    return EXIT_FAILURE;
+  }
+  void* mem = malloc(pool_bytes);
+  pool_t* pool = pool_create(mem, pool_bytes, block_sizes, num_block_size);
+  if(pool == NULL) {
+    printf("The block sizes do not fit in %zu bytes\n", pool_bytes);
+    return EXIT_FAILURE;
+  }
+  if(splitting && !pool_set_splitting_h(pool, true)) {
+    printf("-s needs a build configured with --enable-slot-splitting\n");
+    return EXIT_FAILURE;
+  }
+
+  // Room for every event's block, so that probing always ends on an empty slot
+  live_map_t map;
+  size_t map_len = 2;
+  while(map_len < 2 * num_events) {
+    map_len *= 2;
+  }
+  map.slots = calloc(map_len, sizeof(live_block_t));
+  map.mask = map_len - 1;
+
+  printf("Replaying %s: %zu events, %llu dropped while tracing, timestamps in %s\n", path, num_events, (unsigned long long)header.dropped,
+         (header.clock == POOL_TRACE_CLOCK_TSC) ? "cycles" : "ns");
+  printf("%14s %9s %9s %9s %9s %12s %12s %7s %12s\n", "time", "events", "failures", "spills", "live", "requested B", "held B", "frag %", "free B");
+
+  uint64_t traced_pool = events[0].pool;
+  size_t skipped = 0;
+  size_t unmatched_frees = 0;
+  size_t traced_failures = 0;
+  size_t failures = 0;
+  size_t window_failures = 0;
+  size_t live = 0;
+  uint64_t requested_bytes = 0;
+  uint64_t held_bytes = 0;
+  uint64_t spills_before = 0;
+  size_t window_len = (num_events + windows - 1) / windows;
+  size_t window_events = 0;
+  for(size_t e = 0; e < num_events; e++) {
+    const pool_trace_event_t* event = &events[e];
+    if(event->pool != traced_pool) {
+      skipped++;
+    } else if(event->op == POOL_TRACE_MALLOC) {
+      void* ptr = pool_malloc_h(pool, event->size);
+      if(ptr == NULL) {
+        window_failures++;
+      }
+      if(event->ptr == 0) {
+        // The traced program got nothing and never frees this block
+        traced_failures++;
+        pool_free_h(pool, ptr);
+      } else if(ptr != NULL) {
+        live_block_t* block = liveFind(&map, event->ptr, true);
+        if(block->traced == event->ptr) {
+          // The traced block was freed without an event, e.g. by pool_reset; free it here too
+          held_bytes -= pool_usable_size_h(pool, block->ptr);
+          pool_free_h(pool, block->ptr);
+          live--;
+          requested_bytes -= block->size;
+        }
+        *block = (live_block_t){.traced = event->ptr, .ptr = ptr, .size = event->size};
+        live++;
+        requested_bytes += event->size;
+        held_bytes += pool_usable_size_h(pool, ptr);
+      }
+    } else if(event->op == POOL_TRACE_FREE) {
+      live_block_t* block = liveFind(&map, event->ptr, false);
+      if(block == NULL) {
+        // Allocated before tracing started, or the replayed allocation failed
+        unmatched_frees++;
+      } else {
+        held_bytes -= pool_usable_size_h(pool, block->ptr);
+        pool_free_h(pool, block->ptr);
+        live--;
+        requested_bytes -= block->size;
+        block->traced = SLOT_DELETED;
+      }
+    }
+
+    if((++window_events == window_len) || (e + 1 == num_events)) {
+      uint64_t spills;
+      uint64_t free_bytes;
+      sumStats(pool, num_block_size, &spills, &free_bytes);
+      double frag = (held_bytes > 0) ? 100.0 * (double)(held_bytes - requested_bytes) / (double)held_bytes : 0.0;
+      printf("%14llu %9zu %9zu %9llu %9zu %12llu %12llu %7.1f %12llu\n", (unsigned long long)(event->timestamp - events[0].timestamp), window_events,
+             window_failures, (unsigned long long)(spills - spills_before), live, (unsigned long long)requested_bytes, (unsigned long long)held_bytes,
+             frag, (unsigned long long)free_bytes);
+      failures += window_failures;
+      spills_before = spills;
+      window_events = 0;
+      window_failures = 0;
+    }
+  }
+
+  printf("\n%zu failed allocations against %zu in the trace; %zu frees of blocks the replay does not hold; %zu events of other pools skipped\n",
+         failures, traced_failures, unmatched_frees, skipped);
+  printf("%10s %10s %10s %10s %10s\n", "block size", "capacity", "high water", "spills", "failures");
+  pool_region_stats_t stats[UCHAR_MAX];
+  pool_stats_h(pool, stats, num_block_size);
+  for(size_t i = 0; i < num_block_size; i++) {
+    printf("%10zu %10zu %10llu %10llu %10llu\n", stats[i].block_size, stats[i].capacity, (unsigned long long)stats[i].high_water,
+           (unsigned long long)stats[i].spills, (unsigned long long)stats[i].failures);
+  }
+  if(splitting) {
+    pool_split_stats_t split_stats;
+    pool_split_stats_h(pool, &split_stats);
+    printf("\n%llu slots split, %llu merged back, %llu requests served from sub-slots, %llu found the split table full\n",
+           (unsigned long long)split_stats.splits, (unsigned long long)split_stats.merges, (unsigned long long)split_stats.borrows,
+           (unsigned long long)split_stats.table_full);
+    printf("At the end: %llu slots split into %llu sub-slots, %llu live, %llu B idle\n", (unsigned long long)split_stats.split_slots,
+           (unsigned long long)split_stats.sub_slots, (unsigned long long)split_stats.sub_live, (unsigned long long)split_stats.idle_bytes);
+  }
+  free(map.slots);
+  free(mem);
+  free(events);
+  return EXIT_SUCCESS;
+}
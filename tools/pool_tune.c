@@ -0,0 +1,161 @@
+/*
+ ============================================================================
+ Name        : pool_tune.c
+ Author      : Frank Gu
+ Copyright   : MIT 2018
+ Description : Picks block_sizes and per-class block counts from a requested-size
+               histogram written by pool_histogram_save
+ ============================================================================
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include "include/pool_alloc.h"
+
+#define DEFAULT_MAX_CLASSES 8
+
+static void usage(const char* prog) {
+  printf("Usage: %s <histogram file> <pool bytes> [max block sizes, default %d]\n", prog, DEFAULT_MAX_CLASSES);
+}
+
+/*
+ * Reads "size count" lines in ascending size order. Returns the number of entries, or 0 on errors.
+ */
+static size_t readHistogram(const char* path, size_t** sizes, double** counts) {
+  FILE* in = fopen(path, "r");
+  if(in == NULL) {
+    printf("Cannot open %s\n", path);
+    return 0;
+  }
+  size_t num_entries = 0;
+  size_t capacity = 64;
+  *sizes = malloc(capacity * sizeof(size_t));
+  *counts = malloc(capacity * sizeof(double));
+  size_t size;
+  unsigned long long count;
+  while(fscanf(in, "%zu %llu", &size, &count) == 2) {
+    if((size == 0) || ((num_entries > 0) && (size <= (*sizes)[num_entries - 1]))) {
+      printf("%s: sizes must be non-zero and ascending\n", path);
+      num_entries = 0;
+      break;
+    }
+    if(num_entries == capacity) {
+      capacity *= 2;
+      *sizes = realloc(*sizes, capacity * sizeof(size_t));
+      *counts = realloc(*counts, capacity * sizeof(double));
+    }
+    (*sizes)[num_entries] = size;
+    (*counts)[num_entries] = (double)count;
+    num_entries++;
+  }
+  fclose(in);
+  return num_entries;
+}
+
+int main(int argc, char** argv) {
+  if(argc < 3) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t pool_bytes = strtoull(argv[2], NULL, 0);
+  size_t max_classes = (argc > 3) ? strtoull(argv[3], NULL, 0) : DEFAULT_MAX_CLASSES;
+  if((pool_bytes == 0) || (pool_bytes > MAX_POOL_SIZE) || (max_classes == 0) || (max_classes > UCHAR_MAX)) {
+    printf("Pool bytes must be 1..%zu and max block sizes 1..%d\n", (size_t)MAX_POOL_SIZE, UCHAR_MAX);
+    return EXIT_FAILURE;
+  }
+
+  size_t* sizes;
+  double* counts;
+  size_t m = readHistogram(argv[1], &sizes, &counts);
+  if(m == 0) {
+    printf("No histogram entries read\n");
+    return EXIT_FAILURE;
+  }
+  size_t k = (max_classes < m) ? max_classes : m;
+
+  // Prefix sums of request counts and requested bytes, so the waste of serving entries i..j with a
+  // block of sizes[j] is sizes[j] * (req[j + 1] - req[i]) - (bytes[j + 1] - bytes[i])
+  double* req = calloc(m + 1, sizeof(double));
+  double* bytes = calloc(m + 1, sizeof(double));
+  for(size_t j = 0; j < m; j++) {
+    req[j + 1] = req[j] + counts[j];
+    bytes[j + 1] = bytes[j] + counts[j] * sizes[j];
+  }
+
+  // waste[q * m + j]: least internal fragmentation serving entries 0..j with q + 1 block sizes, the largest sizes[j]
+  double* waste = malloc(k * m * sizeof(double));
+  size_t* split = malloc(k * m * sizeof(size_t));
+  for(size_t j = 0; j < m; j++) {
+    waste[j] = sizes[j] * req[j + 1] - bytes[j + 1];
+    split[j] = 0;
+  }
+  for(size_t q = 1; q < k; q++) {
+    for(size_t j = 0; j < m; j++) {
+      waste[q * m + j] = waste[(q - 1) * m + j];
+      split[q * m + j] = split[(q - 1) * m + j];
+      for(size_t i = 1; i <= j; i++) {
+        double w = waste[(q - 1) * m + i - 1] + sizes[j] * (req[j + 1] - req[i]) - (bytes[j + 1] - bytes[i]);
+        if(w < waste[q * m + j]) {
+          waste[q * m + j] = w;
+          split[q * m + j] = i;
+        }
+      }
+    }
+  }
+
+  // Walk the splits back from the largest size, which every block size list must include
+  size_t block_sizes[UCHAR_MAX];
+  size_t demand[UCHAR_MAX];
+  size_t num_classes = 0;
+  size_t j = m;
+  for(size_t q = k; (q > 0) && (j > 0); q--) {
+    size_t i = split[(q - 1) * m + j - 1];
+    block_sizes[num_classes] = sizes[j - 1];
+    demand[num_classes] = (req[j] > req[i]) ? (size_t)(req[j] - req[i]) : 1;
+    num_classes++;
+    j = i;
+  }
+  for(size_t a = 0; a < num_classes / 2; a++) {
+    size_t t = block_sizes[a];
+    block_sizes[a] = block_sizes[num_classes - 1 - a];
+    block_sizes[num_classes - 1 - a] = t;
+    t = demand[a];
+    demand[a] = demand[num_classes - 1 - a];
+    demand[num_classes - 1 - a] = t;
+  }
+
+  // Split the pool in proportion to each block size's share of requests, so no class spills early
+  void* mem = malloc(pool_bytes);
+  size_t capacities[UCHAR_MAX];
+  if(pool_create_sized(mem, pool_bytes, block_sizes, demand, num_classes, POOL_SIZE_BY_WEIGHT, capacities) == NULL) {
+    printf("%zu block sizes do not fit in %zu bytes; try fewer block sizes or a larger pool\n", num_classes, pool_bytes);
+    return EXIT_FAILURE;
+  }
+
+  double total_waste = waste[(k - 1) * m + m - 1];
+  printf("// %zu requests, %.0f bytes requested, %.1f%% internal fragmentation\n", (size_t)req[m], bytes[m], 100.0 * total_waste / (bytes[m] + total_waste));
+  printf("size_t block_sizes[%zu] = {", num_classes);
+  for(size_t c = 0; c < num_classes; c++) {
+    printf("%s%zu", (c > 0) ? ", " : "", block_sizes[c]);
+  }
+  printf("};\n");
+  printf("size_t class_targets[%zu] = {", num_classes);
+  for(size_t c = 0; c < num_classes; c++) {
+    printf("%s%zu", (c > 0) ? ", " : "", capacities[c]);
+  }
+  printf("};   // POOL_SIZE_BY_COUNT, %zu-byte pool\n", pool_bytes);
+
+  free(mem);
+  free(split);
+  free(waste);
+  free(bytes);
+  free(req);
+  free(counts);
+  free(sizes);
+  return EXIT_SUCCESS;
+}